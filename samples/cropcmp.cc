@@ -0,0 +1,85 @@
+// This file is part of drawtiming.
+//
+// Drawtiming is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Drawtiming is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with drawtiming; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// cropcmp full.ppm x y part.ppm
+//
+// Checks that part.ppm, as drawn with --viewport x,y,w,h, is the same
+// as that rectangle of full.ppm.  Exits with 1 and the number of
+// differing pixels when it is not.
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+using namespace std;
+
+struct ppm {
+  int width, height;
+  vector<unsigned char> rgb;
+};
+
+static bool read_ppm (const char *filename, ppm &img)
+{
+  ifstream in (filename, ios::binary);
+  string magic;
+  int maxval;
+  in >> magic >> img.width >> img.height >> maxval;
+  in.get ();
+  if (!in || magic != "P6" || maxval != 255 || img.width <= 0 || img.height <= 0) {
+    cerr << filename << ": not a PPM image" << endl;
+    return false;
+  }
+  img.rgb.resize ((size_t) img.width * img.height * 3);
+  in.read ((char *) &img.rgb[0], img.rgb.size ());
+  if (!in) {
+    cerr << filename << ": truncated" << endl;
+    return false;
+  }
+  return true;
+}
+
+int main (int argc, char *argv[])
+{
+  ppm full, part;
+  if (argc != 5) {
+    cerr << "usage: cropcmp full.ppm x y part.ppm" << endl;
+    return 2;
+  }
+  if (!read_ppm (argv[1], full) || !read_ppm (argv[4], part))
+    return 2;
+
+  int x0 = atoi (argv[2]), y0 = atoi (argv[3]);
+  if (x0 < 0 || y0 < 0 || x0 + part.width > full.width || y0 + part.height > full.height) {
+    cerr << "the viewport is not inside " << argv[1] << endl;
+    return 2;
+  }
+
+  long differ = 0;
+  for (int y = 0; y < part.height; ++ y)
+    for (int x = 0; x < part.width; ++ x) {
+      const unsigned char *a = &part.rgb[((size_t) y * part.width + x) * 3];
+      const unsigned char *b = &full.rgb[((size_t) (y + y0) * full.width + x + x0) * 3];
+      if (a[0] != b[0] || a[1] != b[1] || a[2] != b[2])
+	++ differ;
+    }
+  if (differ) {
+    cerr << differ << " pixels differ" << endl;
+    return 1;
+  }
+  return 0;
+}
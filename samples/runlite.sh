@@ -6,3 +6,35 @@
 ../src/drawtiming -x 1.5 -o memory.ps $srcdir/memory.txt
 ../src/drawtiming -p 640x480 -o sample640x480.ps $srcdir/sample.txt
 ../src/drawtiming -o guenter.ps $srcdir/guenter.txt
+../src/drawtiming --stream 4 -o sample-strip.ps $srcdir/sample.txt
+../src/drawtiming --vcd-clock clk -o counter.ps $srcdir/counter.vcd
+../src/drawtiming --compile guenter.dtb $srcdir/guenter.txt
+../src/drawtiming -o guenter-dtb.ps guenter.dtb
+../src/drawtiming --from 2 --to 6 -o sample-window.ps $srcdir/sample.txt
+../src/drawtiming --signals 'F*,LED' --exclude ARMED -o sample-filter.ps $srcdir/sample.txt
+../src/drawtiming --viewport 100,0,150,60 -o sample-view.ps $srcdir/sample.txt
+../src/drawtiming --raster -o sample.png $srcdir/sample.txt
+../src/drawtiming --raster -x 1.5 --highlight-rows -o memory.ppm $srcdir/memory.txt
+../src/drawtiming -o sample.svg $srcdir/sample.txt
+../src/drawtiming --page-cycles 4 -o sample-pages.ps $srcdir/sample.txt
+../src/drawtiming --page-cycles 4 -o sample.pdf $srcdir/sample.txt
+../src/drawtiming -o memory.dtl $srcdir/memory.txt
+../src/drawtiming -o memory-dtl.svg memory.dtl
+../src/drawtiming -o sample-multi.svg -o sample-thumb.png:0.5 -o sample-multi.pdf $srcdir/sample.txt
+../src/drawtiming --raster -w 20 -o view-full.ppm $srcdir/sample.txt
+../src/drawtiming --raster -w 20 --viewport 13,7,171,148 -o view-part.ppm $srcdir/sample.txt
+./cropcmp view-full.ppm 13 7 view-part.ppm
+../src/drawtiming -o xstate.svg $srcdir/xstate.txt
+grep '>X</text>' xstate.svg
+../src/drawtiming --raster -w 40 -o label-full.ppm $srcdir/longlabel.txt
+../src/drawtiming --raster -w 40 --viewport 150,0,60,60 -o label-part.ppm $srcdir/longlabel.txt
+./cropcmp label-full.ppm 150 0 label-part.ppm
+../src/drawtiming --compile memory.dtb $srcdir/memory.txt
+../src/drawtiming --exclude 'OE*,DATA' -o filter-txt.svg $srcdir/memory.txt
+../src/drawtiming --exclude 'OE*,DATA' -o filter-dtb.svg memory.dtb
+cmp filter-txt.svg filter-dtb.svg
+if ../src/drawtiming --color-bg bogus -o color.ppm $srcdir/sample.txt; then exit 1; fi
+../src/drawtiming -w 200000 --viewport 1234567,0,400,200 -o far.svg $srcdir/sample.txt
+grep 'matrix(1 0 0 1 -1234567 0)' far.svg
+if grep 'e+' far.svg; then exit 1; fi
+../src/drawtiming --color-dep gray50 --color-bg LightGoldenrod -o x11.pdf $srcdir/memory.txt
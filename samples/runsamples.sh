@@ -6,3 +6,4 @@
 ../src/drawtiming -x 1.5 -o memory.gif $srcdir/memory.txt
 ../src/drawtiming -p 640x480 -o sample640x480.gif $srcdir/sample.txt
 ../src/drawtiming -o guenter.gif $srcdir/guenter.txt
+../src/drawtiming --vcd-clock clk -o counter.gif $srcdir/counter.vcd
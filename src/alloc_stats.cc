@@ -0,0 +1,115 @@
+// This file is part of drawtiming.
+//
+// Drawtiming is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Drawtiming is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with drawtiming; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// Counts calls to the global operator new, and the bytes asked for,
+// separately for each phase named by ALLOC_PHASE, and reports them on
+// standard error when the program exits.  Only built with
+// --enable-alloc-stats, as it replaces the allocator for the program.
+// Images are drawn on several threads, so the counts are updated
+// under a lock.
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+#include "timing.h"
+
+#ifdef ALLOC_STATS
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD_H
+#  include <pthread.h>
+#endif
+
+namespace {
+
+  struct phase_count {
+    const char *name;
+    unsigned long count, bytes;
+  };
+
+  // plain storage, so that counting never allocates
+  const int max_phases = 16;
+  phase_count phases[max_phases] = {{"startup", 0, 0}};
+  int num_phases = 1, current = 0;
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+#endif /* HAVE_PTHREAD_H */
+
+  struct reporter {
+    ~reporter ();
+  } report_on_exit;
+};
+
+// ------------------------------------------------------------
+
+void *operator new (size_t size) {
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_lock (&lock);
+#endif /* HAVE_PTHREAD_H */
+  ++ phases[current].count;
+  phases[current].bytes += size;
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_unlock (&lock);
+#endif /* HAVE_PTHREAD_H */
+  void *p = malloc (size ? size : 1);
+  if (p == NULL)
+    throw std::bad_alloc ();
+  return p;
+}
+
+void operator delete (void *p) throw () {
+  free (p);
+}
+
+void operator delete (void *p, size_t) throw () {
+  free (p);
+}
+
+// ------------------------------------------------------------
+
+void timing::alloc_phase (const char *name) {
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_lock (&lock);
+#endif /* HAVE_PTHREAD_H */
+  // phases entered more than once add up
+  int i;
+  for (i = 0; i < num_phases; ++ i)
+    if (!strcmp (phases[i].name, name))
+      break;
+  if (i == num_phases) {
+    if (num_phases == max_phases)
+      -- i;
+    else {
+      phases[i].name = name;
+      ++ num_phases;
+    }
+  }
+  current = i;
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_unlock (&lock);
+#endif /* HAVE_PTHREAD_H */
+}
+
+// ------------------------------------------------------------
+
+reporter::~reporter () {
+  std::cerr << "allocations:" << std::endl;
+  for (int i = 0; i < num_phases; ++ i)
+    std::cerr << "  " << phases[i].name << ": " << phases[i].count << " ("
+	      << phases[i].bytes << " bytes)" << std::endl;
+}
+#endif /* ALLOC_STATS */
@@ -0,0 +1,427 @@
+// This file is part of drawtiming.
+//
+// Drawtiming is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Drawtiming is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with drawtiming; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// Compiled diagrams (.dtb): the parsed timing::data as
+// arrays of 32 bit words in host byte order, so that loading one is a
+// matter of copying arrays out of the mapped file.
+//
+//   "DTB1" byte-order-mark maxlen
+//   names: count, then length and bytes of each, padded to a word
+//   texts: the same
+//   signals: count, then numdelays maxdelays nruns and the runs as
+//            type text start length
+//   dependencies: count, then trigger effect n_trigger n_effect
+//   delays: count, then text trigger effect n_trigger n_effect offset
+//
+// Display lists (.dtl) of a recording_gc, in the same manner:
+//
+//   "DTL1" byte-order-mark width height highlightRows
+//   strings: as names above
+//   reals: count, then the bytes of each double as two words
+//   ops: count, then the words themselves, see display.cc
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+#include "timing.h"
+#include <fstream>
+#include <errno.h>
+#include <string.h>
+#if defined (HAVE_SYS_MMAN_H) && defined (HAVE_MMAP)
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  define USE_MMAP 1
+#endif
+
+using namespace timing;
+using namespace std;
+
+typedef unsigned int word;
+
+static const char magic[4] = {'D', 'T', 'B', '1'};
+static const char list_magic[4] = {'D', 'T', 'L', '1'};
+static const word byte_order = 0x01020304;
+
+// ------------------------------------------------------------
+
+namespace {
+
+  class writer {
+    ofstream out;
+    vector<word> buf;
+
+  public:
+    writer (const string &filename, const char *m = magic) {
+      out.exceptions (ofstream::failbit | ofstream::badbit);
+      out.open (filename.c_str (), ios::binary);
+      out.write (m, sizeof (magic));
+    }
+
+    void put (word w) {
+      buf.push_back (w);
+      if (buf.size () >= 4096)
+	flush ();
+    }
+
+    void put (const string &s) {
+      put (s.size ());
+      flush ();
+      out.write (s.data (), s.size ());
+      static const char pad[sizeof (word)] = {0};
+      out.write (pad, (sizeof (word) - s.size () % sizeof (word)) % sizeof (word));
+    }
+
+    void put (const string_table &t) {
+      put (t.size ());
+      for (unsigned i = 0; i < t.size (); ++ i)
+	put (t[i]);
+    }
+
+    void put_real (double d) {
+      word w[2];
+      memcpy (w, &d, sizeof (w));
+      put (w[0]);
+      put (w[1]);
+    }
+
+    void flush (void) {
+      if (!buf.empty ())
+	out.write ((const char *) &buf[0], buf.size () * sizeof (word));
+      buf.clear ();
+    }
+  };
+
+  class reader {
+    const string &filename;
+    const char *p, *end;
+    string what;
+
+  public:
+    reader (const string &f, const char *begin, size_t size,
+	    const char *w = "compiled diagram")
+      : filename (f), p (begin), end (begin + size), what (w) { }
+
+    const char *need (size_t n) {
+      if ((size_t) (end - p) < n)
+	throw bad_file (filename, ("truncated " + what).c_str ());
+      const char *r = p;
+      p += n;
+      return r;
+    }
+
+    word get (void) {
+      word w;
+      memcpy (&w, need (sizeof (word)), sizeof (word));
+      return w;
+    }
+
+    // a count of items of at least n words each
+    word count (size_t n) {
+      word c = get ();
+      if ((size_t) (end - p) / (n * sizeof (word)) < c)
+	throw bad_file (filename, ("truncated " + what).c_str ());
+      return c;
+    }
+
+    string get_string (void) {
+      word len = get ();
+      const char *s = need (len);
+      need ((sizeof (word) - len % sizeof (word)) % sizeof (word));
+      return string (s, len);
+    }
+
+    void get (string_table &t) {
+      for (word n = count (1); n > 0; -- n)
+	t.intern (get_string ());
+    }
+
+    double get_real (void) {
+      double d;
+      memcpy (&d, need (sizeof (d)), sizeof (d));
+      return d;
+    }
+
+    void check (bool ok) {
+      if (!ok)
+	throw bad_file (filename, ("corrupt " + what).c_str ());
+    }
+
+    void check_id (word id, word limit) {
+      check (id < limit);
+    }
+  };
+
+  // the whole file, mapped into memory where possible
+  class input {
+    char *addr;
+    size_t len;
+    bool mapped;
+
+  public:
+    input (const string &filename) : addr (NULL), len (0), mapped (false) {
+#ifdef USE_MMAP
+      int fd = open (filename.c_str (), O_RDONLY);
+      struct stat st;
+      if (fd >= 0 && fstat (fd, &st) == 0 && S_ISREG (st.st_mode) && st.st_size > 0) {
+	void *a = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (a != MAP_FAILED) {
+	  addr = (char *) a;
+	  len = st.st_size;
+	  mapped = true;
+	}
+      }
+      if (fd >= 0)
+	close (fd);
+      if (mapped)
+	return;
+#endif /* USE_MMAP */
+      ifstream in (filename.c_str (), ios::binary);
+      if (!in)
+	throw bad_file (filename, strerror (errno));
+      in.seekg (0, ios::end);
+      len = in.tellg ();
+      in.seekg (0, ios::beg);
+      addr = new char[len ? len : 1];
+      in.read (addr, len);
+      if (!in)
+	throw bad_file (filename, "read error");
+    }
+
+    ~input () {
+#ifdef USE_MMAP
+      if (mapped) {
+	munmap (addr, len);
+	return;
+      }
+#endif /* USE_MMAP */
+      delete [] addr;
+    }
+
+    const char *data (void) const { return addr; }
+    size_t size (void) const { return len; }
+  };
+};
+
+// ------------------------------------------------------------
+
+void timing::write_binary (const data &d, const string &filename) {
+  writer out (filename);
+
+  out.put (byte_order);
+  out.put (d.maxlen);
+  out.put (d.names);
+  out.put (d.texts);
+
+  out.put (d.signals.size ());
+  for (vector<sigdata>::const_iterator i = d.signals.begin ();
+       i != d.signals.end (); ++ i) {
+    out.put (i->numdelays);
+    out.put (i->maxdelays);
+    // a second value in the last cycle is pushed past maxlen, where
+    // nothing is drawn; only the cycles up to maxlen are kept
+    run_sequence::const_iterator end = i->runs.begin ();
+    while (end != i->runs.end () && end->start < d.maxlen)
+      ++ end;
+    out.put (end - i->runs.begin ());
+    for (run_sequence::const_iterator j = i->runs.begin (); j != end; ++ j) {
+      out.put (j->value.type);
+      out.put (j->value.text);
+      out.put (j->start);
+      out.put (min (j->length, d.maxlen - j->start));
+    }
+  }
+
+  out.put (d.dependencies.size ());
+  for (vector<depdata>::const_iterator i = d.dependencies.begin ();
+       i != d.dependencies.end (); ++ i) {
+    out.put (i->trigger);
+    out.put (i->effect);
+    out.put (i->n_trigger);
+    out.put (i->n_effect);
+  }
+
+  out.put (d.delays.size ());
+  for (vector<delaydata>::const_iterator i = d.delays.begin ();
+       i != d.delays.end (); ++ i) {
+    out.put (i->text);
+    out.put (i->trigger);
+    out.put (i->effect);
+    out.put (i->n_trigger);
+    out.put (i->n_effect);
+    out.put (i->offset);
+  }
+  out.flush ();
+}
+
+// ------------------------------------------------------------
+// leaves out the delays of dropped signals, and stacks the others as
+// if those had never been added.  The offsets of a trigger count up
+// from 0 again each time it is set, see data::add_delay, which gives
+// the groups of delays sharing the space below it.
+
+static void drop_delays (timing::data &d, const vector<sigid> &ids) {
+  vector<int> next (ids.size (), 0), kept (ids.size (), 0);
+  for (vector<sigdata>::iterator i = d.signals.begin (); i != d.signals.end (); ++ i)
+    i->maxdelays = 0;
+
+  vector<delaydata>::iterator k = d.delays.begin ();
+  for (vector<delaydata>::iterator i = d.delays.begin (); i != d.delays.end (); ++ i) {
+    sigid t = i->trigger;
+    bool stacked = i->n_trigger != i->n_effect;
+    if (i->offset != next[t])
+      kept[t] = 0;
+    next[t] = i->offset + stacked;
+    if (ids[t] == no_signal || ids[i->effect] == no_signal)
+      continue;
+    sigdata &trigger = d.signals[ids[t]];
+    i->offset = kept[t];
+    if (stacked && ++ kept[t] > trigger.maxdelays)
+      trigger.maxdelays = kept[t];
+    i->trigger = ids[t];
+    i->effect = ids[i->effect];
+    *k++ = *i;
+  }
+  d.delays.erase (k, d.delays.end ());
+
+  for (sigid t = 0; t < ids.size (); ++ t)
+    if (ids[t] != no_signal && d.signals[ids[t]].numdelays > 0)
+      d.signals[ids[t]].numdelays = kept[t];
+}
+
+// ------------------------------------------------------------
+
+void timing::read_binary (data &d, const string &filename) {
+  if (!d.signals.empty () || d.maxlen)
+    throw bad_file (filename, "a compiled diagram must be the first input");
+
+  input file (filename);
+  reader in (filename, file.data (), file.size ());
+  if (memcmp (in.need (sizeof (magic)), magic, sizeof (magic)))
+    throw bad_file (filename, "not a compiled diagram");
+  if (in.get () != byte_order)
+    throw bad_file (filename, "compiled diagram has the wrong byte order");
+
+  d.maxlen = in.get ();
+  string_table names;
+  d.names = string_table ();
+  d.texts = string_table ();
+  in.get (names);
+  in.get (d.texts);
+
+  // the signal filter applies to a compiled diagram as it does to a
+  // parsed one: the signals it rejects are left out and renumbered
+  word nsignals = in.count (3);
+  in.check (nsignals == names.size ());
+  vector<sigid> ids (nsignals);
+  for (word k = 0; k < nsignals; ++ k)
+    ids[k] = d.signal_id (names[k]);
+
+  sigdata skipped;
+  for (word k = 0; k < nsignals; ++ k) {
+    sigdata &sig = ids[k] == no_signal ? skipped : d.signals[ids[k]];
+    sig.numdelays = in.get ();
+    sig.maxdelays = in.get ();
+    sig.runs.resize (in.count (4));
+    // runs are ordered, don't overlap and end by maxlen
+    unsigned end = 0;
+    for (run_sequence::iterator j = sig.runs.begin (); j != sig.runs.end (); ++ j) {
+      word type = in.get ();
+      in.check_id (type, STATE + 1);
+      j->value.type = (valuetype) type;
+      in.check_id (j->value.text = in.get (), d.texts.size ());
+      j->start = in.get ();
+      j->length = in.get ();
+      in.check (j->start >= end && j->start <= d.maxlen
+		&& j->length > 0 && j->length <= d.maxlen - j->start);
+      end = j->start + j->length;
+    }
+  }
+
+  word ndeps = in.count (4);
+  for (word k = 0; k < ndeps; ++ k) {
+    depdata dep;
+    in.check_id (dep.trigger = in.get (), nsignals);
+    in.check_id (dep.effect = in.get (), nsignals);
+    dep.n_trigger = in.get ();
+    dep.n_effect = in.get ();
+    if ((dep.trigger = ids[dep.trigger]) != no_signal
+	&& (dep.effect = ids[dep.effect]) != no_signal)
+      d.dependencies.push_back (dep);
+  }
+
+  d.delays.resize (in.count (6));
+  for (vector<delaydata>::iterator i = d.delays.begin (); i != d.delays.end (); ++ i) {
+    i->text = in.get_string ();
+    in.check_id (i->trigger = in.get (), nsignals);
+    in.check_id (i->effect = in.get (), nsignals);
+    i->n_trigger = in.get ();
+    i->n_effect = in.get ();
+    i->offset = in.get ();
+  }
+  if (d.signals.size () < nsignals)
+    drop_delays (d, ids);
+}
+
+// ------------------------------------------------------------
+
+void recording_gc::save (const string &filename) const {
+  writer out (filename, list_magic);
+
+  out.put (byte_order);
+  out.put (width);
+  out.put (height);
+  out.put (highlightRows);
+  out.put (strings);
+
+  out.put (reals.size ());
+  for (vector<double>::const_iterator i = reals.begin (); i != reals.end (); ++ i)
+    out.put_real (*i);
+
+  out.put (ops.size ());
+  for (vector<unsigned>::const_iterator i = ops.begin (); i != ops.end (); ++ i)
+    out.put (*i);
+  out.flush ();
+}
+
+// ------------------------------------------------------------
+
+void recording_gc::load (const string &filename) {
+  input file (filename);
+  reader in (filename, file.data (), file.size (), "display list");
+  if (memcmp (in.need (sizeof (list_magic)), list_magic, sizeof (list_magic)))
+    throw bad_file (filename, "not a display list");
+  if (in.get () != byte_order)
+    throw bad_file (filename, "display list has the wrong byte order");
+
+  width = in.get ();
+  height = in.get ();
+  highlightRows = in.get () != 0;
+  strings = string_table ();
+  in.get (strings);
+
+  reals.resize (in.count (2));
+  for (vector<double>::iterator i = reals.begin (); i != reals.end (); ++ i)
+    *i = in.get_real ();
+
+  ops.resize (in.count (1));
+  for (vector<unsigned>::iterator i = ops.begin (); i != ops.end (); ++ i)
+    *i = in.get ();
+  if (!valid ())
+    throw bad_file (filename, "corrupt display list");
+}
@@ -0,0 +1,299 @@
+// This file is part of drawtiming.
+//
+// Drawtiming is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Drawtiming is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with drawtiming; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// Display lists.  Each call is kept as its opcode followed by its
+// arguments, all as words:
+//
+//   coordinates	rounded to integers
+//   names, texts	ids in the string table
+//   point lists	the number of points, then x and y of each
+//   scale, offset	an index into the table of reals
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+#include "timing.h"
+#include <math.h>
+#include <string.h>
+
+using namespace timing;
+using namespace std;
+
+// ------------------------------------------------------------
+
+recording_gc::recording_gc (void) {
+}
+
+recording_gc::~recording_gc (void) {
+}
+
+// ------------------------------------------------------------
+
+void recording_gc::add (unsigned op, unsigned arg) {
+  ops.push_back (op);
+  ops.push_back (arg);
+}
+
+void recording_gc::add (unsigned op, int x1, int y1, int x2, int y2) {
+  ops.push_back (op);
+  ops.push_back (x1);
+  ops.push_back (y1);
+  ops.push_back (x2);
+  ops.push_back (y2);
+}
+
+void recording_gc::add (unsigned op, const Magick::CoordinateList &points) {
+  ops.push_back (op);
+  ops.push_back (points.size ());
+  for (unsigned i = 0; i < points.size (); ++ i) {
+    ops.push_back ((int) floor (points[i].x () + 0.5));
+    ops.push_back ((int) floor (points[i].y () + 0.5));
+  }
+}
+
+void recording_gc::add (unsigned op, double a, double b) {
+  ops.push_back (op);
+  ops.push_back (reals.size ());
+  reals.push_back (a);
+  reals.push_back (b);
+}
+
+// ------------------------------------------------------------
+
+void recording_gc::bezier (const Magick::CoordinateList &points) {
+  add (OP_BEZIER, points);
+}
+
+void recording_gc::fill_color (const std::string &name) {
+  add (OP_FILL_COLOR, strings.intern (name));
+}
+
+void recording_gc::fill_opacity (int op) {
+  add (OP_FILL_OPACITY, op);
+}
+
+void recording_gc::font (const std::string &name) {
+  add (OP_FONT, strings.intern (name));
+}
+
+void recording_gc::line (int x1, int y1, int x2, int y2) {
+  add (OP_LINE, x1, y1, x2, y2);
+}
+
+void recording_gc::polyline (const Magick::CoordinateList &points) {
+  add (OP_POLYLINE, points);
+}
+
+void recording_gc::drawrect (int x1, int y1, int x2, int y2) {
+  add (OP_DRAWRECT, x1, y1, x2, y2);
+}
+
+void recording_gc::point_size (int size) {
+  add (OP_POINT_SIZE, size);
+}
+
+void recording_gc::polygon (const Magick::CoordinateList &points) {
+  add (OP_POLYGON, points);
+}
+
+void recording_gc::pop (void) {
+  ops.push_back (OP_POP);
+}
+
+void recording_gc::push (void) {
+  ops.push_back (OP_PUSH);
+}
+
+void recording_gc::scaling (double hscale, double vscale) {
+  add (OP_SCALING, hscale, vscale);
+}
+
+void recording_gc::translate (double dx, double dy) {
+  add (OP_TRANSLATE, dx, dy);
+}
+
+void recording_gc::stroke_color (const std::string &name) {
+  add (OP_STROKE_COLOR, strings.intern (name));
+}
+
+void recording_gc::stroke_width (int w) {
+  add (OP_STROKE_WIDTH, w);
+}
+
+void recording_gc::text (int x, int y, const std::string &text) {
+  ops.push_back (OP_TEXT);
+  ops.push_back (x);
+  ops.push_back (y);
+  ops.push_back (strings.intern (text));
+}
+
+void recording_gc::row (int y) {
+  add (OP_ROW, y);
+}
+
+// ------------------------------------------------------------
+
+static void get_points (const std::vector<unsigned> &ops, unsigned &i,
+			Magick::CoordinateList &points) {
+  points.clear ();
+  for (unsigned n = ops[i ++]; n > 0; -- n, i += 2)
+    points.push_back (Magick::Coordinate ((int) ops[i], (int) ops[i + 1]));
+}
+
+void recording_gc::replay (gc &target) const {
+  target.width = width;
+  target.height = height;
+  target.highlightRows = highlightRows;
+
+  Magick::CoordinateList points;
+  unsigned i = 0;
+  while (i < ops.size ()) {
+    const unsigned *a = &ops[0] + i + 1;
+    switch (ops[i ++]) {
+    case OP_BEZIER:
+      get_points (ops, i, points);
+      target.bezier (points);
+      break;
+    case OP_FILL_COLOR:
+      target.fill_color (strings[a[0]]);
+      i += 1;
+      break;
+    case OP_FILL_OPACITY:
+      target.fill_opacity ((int) a[0]);
+      i += 1;
+      break;
+    case OP_FONT:
+      target.font (strings[a[0]]);
+      i += 1;
+      break;
+    case OP_LINE:
+      target.line ((int) a[0], (int) a[1], (int) a[2], (int) a[3]);
+      i += 4;
+      break;
+    case OP_POLYLINE:
+      get_points (ops, i, points);
+      target.polyline (points);
+      break;
+    case OP_DRAWRECT:
+      target.drawrect ((int) a[0], (int) a[1], (int) a[2], (int) a[3]);
+      i += 4;
+      break;
+    case OP_POINT_SIZE:
+      target.point_size ((int) a[0]);
+      i += 1;
+      break;
+    case OP_POLYGON:
+      get_points (ops, i, points);
+      target.polygon (points);
+      break;
+    case OP_POP:
+      target.pop ();
+      break;
+    case OP_PUSH:
+      target.push ();
+      break;
+    case OP_SCALING:
+      target.scaling (reals[a[0]], reals[a[0] + 1]);
+      i += 1;
+      break;
+    case OP_TRANSLATE:
+      target.translate (reals[a[0]], reals[a[0] + 1]);
+      i += 1;
+      break;
+    case OP_STROKE_COLOR:
+      target.stroke_color (strings[a[0]]);
+      i += 1;
+      break;
+    case OP_STROKE_WIDTH:
+      target.stroke_width ((int) a[0]);
+      i += 1;
+      break;
+    case OP_TEXT:
+      target.text ((int) a[0], (int) a[1], strings[a[2]]);
+      i += 3;
+      break;
+    case OP_ROW:
+      target.row ((int) a[0]);
+      i += 1;
+      break;
+    }
+  }
+}
+
+// ------------------------------------------------------------
+// whether every call has all its arguments, and every id and index
+// is in range; replay() relies on it for a loaded list
+
+bool recording_gc::valid (void) const {
+  unsigned i = 0;
+  while (i < ops.size ()) {
+    unsigned op = ops[i ++], left = ops.size () - i;
+    switch (op) {
+    case OP_BEZIER:
+    case OP_POLYLINE:
+    case OP_POLYGON:
+      if (left < 1 || (left - 1) / 2 < ops[i])
+	return false;
+      i += 1 + 2 * ops[i];
+      break;
+    case OP_FILL_COLOR:
+    case OP_FONT:
+    case OP_STROKE_COLOR:
+      if (left < 1 || ops[i] >= strings.size ())
+	return false;
+      i += 1;
+      break;
+    case OP_SCALING:
+    case OP_TRANSLATE:
+      if (left < 1 || ops[i] >= reals.size () || reals.size () - ops[i] < 2)
+	return false;
+      i += 1;
+      break;
+    case OP_FILL_OPACITY:
+    case OP_POINT_SIZE:
+    case OP_STROKE_WIDTH:
+    case OP_ROW:
+      if (left < 1)
+	return false;
+      i += 1;
+      break;
+    case OP_LINE:
+    case OP_DRAWRECT:
+      if (left < 4)
+	return false;
+      i += 4;
+      break;
+    case OP_TEXT:
+      if (left < 3 || ops[i + 2] >= strings.size ())
+	return false;
+      i += 3;
+      break;
+    case OP_POP:
+    case OP_PUSH:
+      break;
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+
+// ------------------------------------------------------------
+
+bool recording_gc::has_dtl_ext (const std::string &filename) {
+  std::string::size_type dot = filename.rfind ('.');
+  return dot != std::string::npos && !strcasecmp (filename.c_str () + dot + 1, "dtl");
+}
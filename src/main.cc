@@ -20,7 +20,15 @@
 #ifdef HAVE_CONFIG_H
 #  include <config.h>
 #endif
-#include "globals.h"
+#include "parse.h"
+#include <fstream>
+#include <string.h>
+#ifdef HAVE_UNISTD_H
+#  include <unistd.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#  include <pthread.h>
+#endif
 #ifdef HAVE_GETOPT_H
 #  include <getopt.h>
 #else
@@ -37,36 +45,46 @@ using namespace Magick;
 #define FLAG_ASPECT 4
 #define FLAG_HIGHLIGHT_ROWS 8
 
-extern FILE *yyin;
 extern int yydebug;
-int yyparse (void);
 static void usage (void);
 static void banner (void);
 static void freesoft (void);
 
-unsigned n;
-timing::data tdata;
-timing::signal_sequence deps;
-string outfile;
 int verbose = 0;
 
 enum option_t {
     OPT_ASPECT = 0x100,
     OPT_CELL_HEIGHT,
     OPT_CELL_WIDTH,
+    OPT_FIT_TEXT,
     OPT_FONT,
+    OPT_FROM,
     OPT_FONT_SIZE,
 	OPT_COLOR_BACKGROUND,
 	OPT_COLOR_FOREGROUND,
 	OPT_COLOR_DEPEND,
+    OPT_COMPILE,
+    OPT_EXCLUDE,
     OPT_HELP,
     OPT_HIGHLIGHT_ROWS,
     OPT_LINE_WIDTH,
+    OPT_METRICS_CACHE,
     OPT_OUTPUT,
     OPT_SCALE,
+    OPT_SIGNALS,
+    OPT_PAGE_CYCLES,
     OPT_PAGESIZE,
+    OPT_RASTER,
+    OPT_STREAM,
+    OPT_THREADS,
+    OPT_TO,
+    OPT_VCD_CLOCK,
+    OPT_VCD_PERIOD,
+    OPT_VCD_SCOPE,
+    OPT_VCD_SIGNALS,
     OPT_VERBOSE,
-    OPT_VERSION
+    OPT_VERSION,
+    OPT_VIEWPORT
 };
 
 #ifdef HAVE_GETOPT_H
@@ -78,33 +96,385 @@ struct option opts[] = {
   {"color-bg", required_argument, NULL, OPT_COLOR_BACKGROUND},
   {"color-fg", required_argument, NULL, OPT_COLOR_FOREGROUND},
   {"color-dep", required_argument, NULL, OPT_COLOR_DEPEND},
+  {"compile", required_argument, NULL, OPT_COMPILE},
+  {"exclude", required_argument, NULL, OPT_EXCLUDE},
+  {"fit-text", no_argument, NULL, OPT_FIT_TEXT},
   {"font", required_argument, NULL, OPT_FONT},
   {"font-size", required_argument, NULL, OPT_FONT_SIZE},
+  {"from", required_argument, NULL, OPT_FROM},
   {"help", no_argument, NULL, OPT_HELP},
   {"highlight-rows",no_argument, NULL, OPT_HIGHLIGHT_ROWS},
   {"line-width", required_argument, NULL, OPT_LINE_WIDTH},
+  {"metrics-cache", required_argument, NULL, OPT_METRICS_CACHE},
   {"output", required_argument, NULL, OPT_OUTPUT},
   {"scale", required_argument, NULL, OPT_SCALE},
+  {"page-cycles", required_argument, NULL, OPT_PAGE_CYCLES},
   {"pagesize", required_argument, NULL, OPT_PAGESIZE},
+  {"raster", no_argument, NULL, OPT_RASTER},
+  {"signals", required_argument, NULL, OPT_SIGNALS},
+  {"stream", required_argument, NULL, OPT_STREAM},
+  {"threads", required_argument, NULL, OPT_THREADS},
+  {"to", required_argument, NULL, OPT_TO},
+  {"vcd-clock", required_argument, NULL, OPT_VCD_CLOCK},
+  {"vcd-period", required_argument, NULL, OPT_VCD_PERIOD},
+  {"vcd-scope", required_argument, NULL, OPT_VCD_SCOPE},
+  {"vcd-signals", required_argument, NULL, OPT_VCD_SIGNALS},
   {"verbose", no_argument, NULL, OPT_VERBOSE},
   {"version", no_argument, NULL, OPT_VERSION},
+  {"viewport", required_argument, NULL, OPT_VIEWPORT},
   {0, 0, 0, 0}
 };
 #endif
 
-static void render_it (timing::gc& gc, int flags,
-    		       int width, int height, double scale)
+static timing::viewport view;
+static int threads = 0;
+static bool raster = false;
+static unsigned page_cycles = 0;
+static const timing::recording_gc *display_list = NULL; // the input, if one was given
+
+// an output file, with its own scale or page size when named as
+// file:scale or file:WxH
+struct output {
+  string filename;
+  int flags, width, height;
+  double scale;
+};
+static vector<output> outputs;
+
+static void render_it (timing::gc& gc, const timing::data &tdata, int flags,
+    		       int width, int height, double scale,
+		       unsigned from, unsigned to, const timing::recording_gc *list)
 {
+  if (list) {
+    list->replay (gc);
+    return;
+  }
+  bool highlight = (flags & FLAG_HIGHLIGHT_ROWS) != 0;
   if (flags & FLAG_PAGESIZE)
-    render (gc, tdata, width, height, (flags & FLAG_ASPECT),(flags & FLAG_HIGHLIGHT_ROWS));
+    render (gc, tdata, width, height, (flags & FLAG_ASPECT) != 0, highlight, from, to, view);
   else
-    render (gc, tdata, scale,(flags & FLAG_HIGHLIGHT_ROWS));
+    render (gc, tdata, scale, highlight, from, to, view);
 }
 
+// a page for each page_cycles of [from, to)
+
+template <class paged_gc>
+static void render_pages (paged_gc &gc, const timing::data &tdata, int flags,
+			  int width, int height, double scale,
+			  unsigned from, unsigned to)
+{
+  for (unsigned p = from; p < to; p += page_cycles) {
+    gc.page ();
+    render_it (gc, tdata, flags, width, height, scale, p, min (p + page_cycles, to), NULL);
+  }
+}
+
+// with a display list, that is drawn instead of the diagram
+
+static void write_it (const string &filename, const timing::data &tdata, int flags,
+		      int width, int height, double scale,
+		      unsigned from = 0, unsigned to = ~0u,
+		      const timing::recording_gc *list = NULL)
+{
+  if (filename == "-" || timing::postscript_gc::has_ps_ext (filename)) {
+    // "-" is Postscript on the standard output
+    ofstream out;
+    if (filename != "-") {
+      out.exceptions (ofstream::failbit | ofstream::badbit);
+      out.open (filename.c_str ());
+    }
+    bool eps = timing::postscript_gc::has_eps_ext (filename);
+    timing::postscript_gc gc (filename == "-" ? cout : out, eps);
+    if (page_cycles && !eps) {
+      unsigned end = min (to, tdata.maxlen);
+      gc.pages = end > from ? (end - from + page_cycles - 1) / page_cycles : 0;
+      render_pages (gc, tdata, flags, width, height, 1.0, from, end);
+    }
+    else
+      render_it (gc, tdata, flags, width, height, 1.0, from, to, list);
+
+    gc.finish ();
+  } else if (timing::pdf_gc::has_pdf_ext (filename)) {
+    ofstream out;
+    out.exceptions (ofstream::failbit | ofstream::badbit);
+    out.open (filename.c_str (), ios::binary);
+    timing::pdf_gc gc (out);
+    if (page_cycles)
+      render_pages (gc, tdata, flags, width, height, 1.0, from, min (to, tdata.maxlen));
+    else
+      render_it (gc, tdata, flags, width, height, 1.0, from, to, list);
+
+    gc.finish ();
+  } else if (timing::svg_gc::has_svg_ext (filename)) {
+    ofstream out;
+    out.exceptions (ofstream::failbit | ofstream::badbit);
+    out.open (filename.c_str ());
+    timing::svg_gc gc (out);
+    render_it (gc, tdata, flags, width, height, scale, from, to, list);
+
+    gc.finish ();
+  } else if (timing::recording_gc::has_dtl_ext (filename)) {
+    timing::recording_gc gc;
+    render_it (gc, tdata, flags, width, height, scale, from, to, list);
+
+    gc.save (filename);
+  } else if (raster) {
+    timing::raster_gc gc;
+    render_it (gc, tdata, flags, width, height, scale, from, to, list);
+
+    gc.print (filename);
+  } else {
+#ifndef LITE
+    timing::magick_gc gc;
+    gc.threads = threads;
+    render_it (gc, tdata, flags, width, height, scale, from, to, list);
+
+    Image img (Geometry (gc.width, gc.height), timing::vColor_Bg);
+    gc.draw (img);
+    img.write (filename);
+#endif /* ! LITE */
+  }
+}
+
+// ------------------------------------------------------------
+
+static bool has_ext (const string &filename, const char *ext)
+{
+  string::size_type dot = filename.rfind ('.');
+  return dot != string::npos && !strcasecmp (filename.c_str () + dot + 1, ext);
+}
+
+// ------------------------------------------------------------
+
+static void split_list (const char *s, vector<string> &list)
+{
+  string item;
+  for (; *s; ++ s)
+    if (*s == ',') {
+      if (!item.empty ())
+	list.push_back (item);
+      item.erase ();
+    }
+    else
+      item += *s;
+  if (!item.empty ())
+    list.push_back (item);
+}
+
+// ------------------------------------------------------------
+// "thumb.png:0.25" and "page.png:640x480" name an output with its own
+// scale or page size; a colon followed by anything else is part of
+// the name.  Outputs without their own get the global ones later.
+
+static output parse_output (const char *arg)
+{
+  output o;
+  o.filename = arg;
+  o.flags = -1;
+  o.width = o.height = 0;
+  o.scale = 1;
+
+  string::size_type colon = o.filename.rfind (':');
+  if (colon == string::npos || colon < 2)	// nor a drive letter
+    return o;
+  const char *geom = arg + colon + 1;
+  char extra;
+  if (sscanf (geom, "%dx%d%c", &o.width, &o.height, &extra) == 2)
+    o.flags = FLAG_PAGESIZE;
+  else if (sscanf (geom, "%lf%c", &o.scale, &extra) == 1)
+    o.flags = FLAG_SCALE;
+  else
+    return o;
+  o.filename.erase (colon);
+  return o;
+}
+
+// ------------------------------------------------------------
+// "trace.png" becomes "trace-0001.png" for the first strip
+
+static string strip_name (const string &filename, int strip)
+{
+  string::size_type dot = filename.rfind ('.');
+  string::size_type dir = filename.find_last_of ("/\\");
+  if (dot == string::npos || (dir != string::npos && dot < dir))
+    dot = filename.size ();
+
+  char num[16];
+  sprintf (num, "-%04d", strip);
+  return filename.substr (0, dot) + num + filename.substr (dot);
+}
+
+// ------------------------------------------------------------
+// with page_cycles, Postscript and PDF have a page of that many cycles
+// after another, and other formats are written as a numbered file for
+// each
+
+static void write_pages (const string &filename, const timing::data &tdata, int flags,
+			 int width, int height, double scale, unsigned from, unsigned to)
+{
+  if (!page_cycles || filename == "-" || timing::pdf_gc::has_pdf_ext (filename)
+      || (timing::postscript_gc::has_ps_ext (filename)
+	  && !timing::postscript_gc::has_eps_ext (filename))) {
+    write_it (filename, tdata, flags, width, height, scale, from, to, display_list);
+    return;
+  }
+
+  unsigned end = min (to, tdata.maxlen);
+  int page = 0;
+  for (unsigned p = from; p < end; p += page_cycles)
+    write_it (strip_name (filename, ++ page), tdata, flags, width, height, scale,
+	      p, min (p + page_cycles, end));
+}
+
+// ------------------------------------------------------------
+// several outputs share one layout for each distinct scale or page
+// size: it is recorded once, then every output is drawn from its
+// display list on a thread of its own.  A single output, and paged
+// output, as a display list has no pages, are laid out for each file
+// in turn instead.  Either way an output which fails is reported
+// without stopping the others.
+
+namespace {
+  struct job {
+    const output *out;
+    const timing::data *tdata;
+    unsigned from, to;
+    const timing::recording_gc *list;
+    string error;
+  };
+};
+
+static void *write_job (void *arg)
+{
+  job *j = (job *) arg;
+  try {
+    if (j->list)
+      write_it (j->out->filename, *j->tdata, j->out->flags, j->out->width,
+		j->out->height, j->out->scale, j->from, j->to, j->list);
+    else
+      write_pages (j->out->filename, *j->tdata, j->out->flags, j->out->width,
+		   j->out->height, j->out->scale, j->from, j->to);
+  }
+  catch (std::exception &err) {
+    j->error = j->out->filename + ": " + err.what ();
+  }
+  return NULL;
+}
+
+// Postscript and PDF are always laid out at scale 1
+
+static double layout_scale (const output &o)
+{
+  if (o.filename == "-" || timing::postscript_gc::has_ps_ext (o.filename)
+      || timing::pdf_gc::has_pdf_ext (o.filename))
+    return 1.0;
+  return o.scale;
+}
+
+static bool same_layout (const output &a, const output &b)
+{
+  if (a.flags != b.flags)
+    return false;
+  if (a.flags & FLAG_PAGESIZE)
+    return a.width == b.width && a.height == b.height;
+  return layout_scale (a) == layout_scale (b);
+}
+
+static bool write_outputs (const timing::data &tdata, unsigned from, unsigned to)
+{
+  bool shared = outputs.size () > 1 && !page_cycles;
+
+  // the first output of each layout records it
+  vector<unsigned> layout (outputs.size ());
+  vector<timing::recording_gc> lists;
+  for (unsigned i = 0; i < outputs.size () && shared && !display_list; ++ i) {
+    unsigned k = 0;
+    while (k < i && !same_layout (outputs[k], outputs[i]))
+      ++ k;
+    if (k < i) {
+      layout[i] = layout[k];
+      continue;
+    }
+    layout[i] = lists.size ();
+    lists.push_back (timing::recording_gc ());
+    const output &o = outputs[i];
+    render_it (lists.back (), tdata, o.flags, o.width, o.height, layout_scale (o),
+	       from, to, NULL);
+  }
+
+  vector<job> jobs (outputs.size ());
+  for (unsigned i = 0; i < jobs.size (); ++ i) {
+    jobs[i].out = &outputs[i];
+    jobs[i].tdata = &tdata;
+    jobs[i].from = from;
+    jobs[i].to = to;
+    jobs[i].list = display_list || !shared ? display_list : &lists[layout[i]];
+  }
+
+  // the first job is done on this thread, while the others run
+#ifdef HAVE_PTHREAD_H
+  vector<pthread_t> ids (jobs.size ());
+  vector<bool> started (jobs.size ());
+  for (unsigned k = 1; shared && k < jobs.size (); ++ k)
+    started[k] = pthread_create (&ids[k], NULL, write_job, &jobs[k]) == 0;
+  for (unsigned k = 0; k < jobs.size (); ++ k)
+    if (started[k])
+      pthread_join (ids[k], NULL);
+    else
+      write_job (&jobs[k]);
+#else
+  for (unsigned k = 0; k < jobs.size (); ++ k)
+    write_job (&jobs[k]);
+#endif /* HAVE_PTHREAD_H */
+
+  bool ok = true;
+  for (unsigned k = 0; k < jobs.size (); ++ k)
+    if (!jobs[k].error.empty ()) {
+      cerr << "caught exception writing " << jobs[k].error << endl;
+      ok = false;
+    }
+  return ok;
+}
+
+// ------------------------------------------------------------
+// renders each strip of cycles as soon as the parser has finished
+// it, then drops it from memory
+
+struct stream_context : public timing::parse_context {
+  unsigned cycles, from;
+  int strip;
+  const output *out;
+
+  stream_context (timing::data &d, unsigned c, const output *o)
+    : parse_context (d), cycles (c), from (0), strip (0), out (o) { }
+
+  void end_timeslice (void) {
+    while (n >= from + cycles)
+      flush (from + cycles);
+  }
+
+  void flush (unsigned to) {
+    tdata.pad (to);
+    ALLOC_PHASE ("render");
+    write_it (strip_name (out->filename, ++ strip), tdata, out->flags, out->width,
+	      out->height, out->scale, from, to);
+    from = to;
+    // keep the last cycle, the next strip starts with a transition from it
+    tdata.discard (from - 1);
+    ALLOC_PHASE ("parse");
+  }
+};
+
 int main (int argc, char *argv[]) {
-  int width, height;
+  int width = 0, height = 0;
   double scale = 1;
   int flags = 0;
+  int stream = 0;
+  string compiled;
+  unsigned from = 0, to = ~0u;
+  timing::signal_filter filter;
+  string metrics_cache;
+  timing::vcd_options vcd;
 
   int k, c;
   while ((c = getopt_long (argc, argv, "ac:f:hl:o:p:vVw:x:", opts, &k)) != -1)
@@ -126,6 +496,15 @@ int main (int argc, char *argv[]) {
 	case OPT_COLOR_DEPEND:
 	  timing::vColor_Dep=optarg;
 	  break;
+    case OPT_COMPILE:
+      compiled = optarg;
+      break;
+    case OPT_EXCLUDE:
+      split_list (optarg, filter.exclude);
+      break;
+    case OPT_FIT_TEXT:
+      timing::vFitText = true;
+      break;
     case OPT_FONT:
       timing::vFont = optarg;
       break;
@@ -133,6 +512,9 @@ int main (int argc, char *argv[]) {
     case OPT_FONT_SIZE:
       timing::vFontPointsize = atoi (optarg);
       break;    
+    case OPT_FROM:
+      from = strtoul (optarg, NULL, 10);
+      break;
     case 'h':
     case OPT_HELP:
       usage ();
@@ -142,9 +524,15 @@ int main (int argc, char *argv[]) {
     case OPT_LINE_WIDTH:
       timing::vLineWidth = atoi (optarg);
       break;    
+    case OPT_METRICS_CACHE:
+      metrics_cache = optarg;
+      break;
     case 'o':
     case OPT_OUTPUT:
-      outfile = optarg;
+      outputs.push_back (parse_output (optarg));
+      break;
+    case OPT_PAGE_CYCLES:
+      page_cycles = strtoul (optarg, NULL, 10);
       break;
     case 'p':
     case OPT_PAGESIZE:
@@ -156,6 +544,33 @@ int main (int argc, char *argv[]) {
       flags |= FLAG_SCALE;
       scale = atof (optarg);
       break;
+    case OPT_RASTER:
+      raster = true;
+      break;
+    case OPT_SIGNALS:
+      split_list (optarg, filter.include);
+      break;
+    case OPT_STREAM:
+      stream = atoi (optarg);
+      break;
+    case OPT_THREADS:
+      threads = atoi (optarg);
+      break;
+    case OPT_TO:
+      to = strtoul (optarg, NULL, 10);
+      break;
+    case OPT_VCD_CLOCK:
+      vcd.clock = optarg;
+      break;
+    case OPT_VCD_PERIOD:
+      vcd.period = strtoull (optarg, NULL, 10);
+      break;
+    case OPT_VCD_SCOPE:
+      vcd.scope = optarg;
+      break;
+    case OPT_VCD_SIGNALS:
+      split_list (optarg, vcd.signals);
+      break;
     case 'v':
     case OPT_VERBOSE:
       ++ verbose;
@@ -166,6 +581,13 @@ int main (int argc, char *argv[]) {
       freesoft ();
       exit (0);
        break;
+    case OPT_VIEWPORT:
+      if (sscanf (optarg, "%d,%d,%d,%d", &view.x, &view.y, &view.w, &view.h) != 4
+	  || view.empty ()) {
+	cerr << "Bad viewport given (" << optarg << ")" << endl;
+	exit (2);
+      }
+      break;
     case 'w':
     case OPT_CELL_WIDTH:
       timing::vCellW = atoi (optarg);
@@ -195,43 +617,128 @@ int main (int argc, char *argv[]) {
     exit (2);
   }
 
+  for (vector<output>::iterator o = outputs.begin (); o != outputs.end (); ++ o) {
+    if (o->flags < 0) {
+      o->flags = flags & (FLAG_SCALE | FLAG_PAGESIZE);
+      o->width = width;
+      o->height = height;
+      o->scale = scale;
+    }
+    else if ((o->flags & FLAG_SCALE) ? o->scale <= 0 : o->width <= 0 || o->height <= 0) {
+      cerr << "Bad scale factor or page size given for " << o->filename << endl;
+      exit (2);
+    }
+    o->flags |= flags & (FLAG_ASPECT | FLAG_HIGHLIGHT_ROWS);
+  }
+
+  if (stream < 0 || (stream > 0 && (outputs.size () != 1 || outputs[0].filename == "-"))) {
+    cerr << "The stream option needs a positive strip length and a single output file" << endl;
+    exit (2);
+  }
+
+#ifdef LITE
+  // without ImageMagick the built-in rasterizer is all there is
+  raster = true;
+#endif /* LITE */
+  for (vector<output>::iterator o = outputs.begin (); o != outputs.end (); ++ o)
+    if (raster && o->filename != "-"
+	&& !timing::postscript_gc::has_ps_ext (o->filename)
+	&& !timing::svg_gc::has_svg_ext (o->filename)
+	&& !timing::pdf_gc::has_pdf_ext (o->filename)
+	&& !timing::recording_gc::has_dtl_ext (o->filename)
+	&& !timing::raster_gc::has_raster_ext (o->filename)) {
+      cerr << "Only PNG, PPM, SVG, PDF, Postscript and display list output can be drawn without ImageMagick" << endl;
+      exit (2);
+    }
+
+  if (threads <= 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+    threads = sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+    if (threads <= 0)
+      threads = 1;
+  }
+
+  if (from >= to) {
+    cerr << "Bad cycle range given (" << from << " to " << to << ")" << endl;
+    exit (2);
+  }
+
+  if (stream && (from > 0 || to != ~0u)) {
+    cerr << "The stream option can not be combined with from and to" << endl;
+    exit (2);
+  }
+
+  if (stream && page_cycles) {
+    cerr << "The stream and page-cycles options are mutually exclusive" << endl;
+    exit (2);
+  }
+
+  if (stream && !compiled.empty ()) {
+    cerr << "The stream and compile options are mutually exclusive" << endl;
+    exit (2);
+  }
+
   yydebug = 0;
   if (verbose > 1)
     yydebug = 1;
 
+  if (!metrics_cache.empty ())
+    timing::vMetrics.load (metrics_cache);
+
   try {
+    timing::data tdata;
+    timing::recording_gc list;
+    tdata.filter = filter;
+    timing::parse_context whole (tdata);
+    stream_context strips (tdata, stream, stream ? &outputs[0] : NULL);
+    timing::parse_context &ctx = stream ? strips : whole;
+
+    ALLOC_PHASE ("parse");
     for (int i = optind; i < argc; ++ i) {
-      yyin = fopen (argv[i], "rt");
-      if (yyin == NULL) 
-	perror (argv[i]);
-      else {
-	if (yyparse () != 0)
+      int result = 0;
+      if (timing::recording_gc::has_dtl_ext (argv[i])) {
+	if (argc - optind > 1 || stream || page_cycles || !compiled.empty ()) {
+	  cerr << "A display list must be the only input, and can not be streamed," << endl
+	       << "paged or compiled" << endl;
 	  exit (2);
-	fclose (yyin);
+	}
+	list.load (argv[i]);
+	display_list = &list;
+      }
+      else if (has_ext (argv[i], "dtb")) {
+	timing::read_binary (tdata, argv[i]);
+	ctx.n = max (ctx.n, tdata.maxlen);
       }
+      else if (has_ext (argv[i], "vcd"))
+	result = timing::read_vcd (argv[i], ctx, vcd);
+      else
+	result = timing::parse (argv[i], ctx);
+      if (result < 0)
+	perror (argv[i]);
+      else if (result != 0)
+	exit (2);
     }
 
-    tdata.pad (n);
-    if (verbose)
-      cout << tdata;
-
-    if (outfile.empty ())
-      return 0;
-
-    if (timing::postscript_gc::has_ps_ext (outfile)) {
-      timing::postscript_gc gc;
-      render_it (gc, flags, width, height, 1.0);
+    if (stream) {
+      unsigned end = max (ctx.n, tdata.maxlen);
+      while (end > strips.from)
+	strips.flush (min (strips.from + strips.cycles, end));
+    }
+    else {
+      ALLOC_PHASE ("pad");
+      tdata.pad (ctx.n);
+      if (verbose)
+	cout << tdata;
 
-      gc.print (outfile);
-    } else {
-#ifndef LITE
-      timing::magick_gc gc;
-      render_it (gc, flags, width, height, scale);
+      if (!compiled.empty ())
+	timing::write_binary (tdata, compiled);
 
-      Image img (Geometry (gc.width, gc.height), timing::vColor_Bg);
-      gc.draw (img);
-      img.write (outfile);
-#endif /* ! LITE */
+      if (!outputs.empty ()) {
+	ALLOC_PHASE ("render");
+	if (!write_outputs (tdata, from, to))
+	  return 2;
+      }
     }
   }
 #ifndef LITE
@@ -244,7 +751,13 @@ int main (int argc, char *argv[]) {
     cerr << "caught timing exception: " << err.what () << endl;
     return 2;
   }
+  catch (std::exception &err) {
+    cerr << "caught exception: " << err.what () << endl;
+    return 2;
+  }
 
+  if (!metrics_cache.empty ())
+    timing::vMetrics.save (metrics_cache);
   return 0;
 }
 
@@ -281,7 +794,19 @@ void usage (void) {
        << endl
        << "    In addition to the formats supported by ImageMagick, Postscript " << endl
        << "    output can be generated (this is enabled when the output filename's " << endl
-       << "    extension is either \"ps\" or \"eps\")." << endl
+       << "    extension is either \"ps\" or \"eps\"), and SVG output when it is" << endl
+       << "    \"svg\", and PDF when it is \"pdf\". With \"-\" as the filename" << endl
+       << "    Postscript goes to the standard output." << endl
+       << endl
+       << "    The option can be given more than once to write several outputs," << endl
+       << "    which share the parsing and layout and are written concurrently." << endl
+       << "    A name ending in \":<scale>\" or \":<width>x<height>\", such as" << endl
+       << "    thumb.png:0.25, gives that output its own scale or page size." << endl
+       << endl
+       << "    Output named *.dtl is a display list: what would be drawn, kept" << endl
+       << "    to be drawn later in any of the other formats. An input file named" << endl
+       << "    *.dtl is drawn as it was laid out, so the options which change the" << endl
+       << "    layout have no effect then; it must be the only input." << endl
        << "-x <float>" << endl
        << "--scale <float>" << endl
        << "    Scales the canvas size on which to render. This option has no effect" << endl
@@ -289,6 +814,49 @@ void usage (void) {
        << "-p <width>x<height>" << endl
        << "--pagesize <width>x<height>" << endl
        << "    Specify the canvas size to render on." << endl
+       << "--page-cycles <cycles>" << endl
+       << "    Split the diagram into pages of the given number of cycles, each" << endl
+       << "    with the signal names. Postscript and PDF output have them as pages" << endl
+       << "    of one document, other formats as numbered files, outfile-0001.gif" << endl
+       << "    and so on. With --pagesize each page is scaled to that size." << endl
+       << "--stream <cycles>" << endl
+       << "    Render the diagram as a series of strips of the given number of" << endl
+       << "    cycles while the input is read, keeping only the current strip in" << endl
+       << "    memory. Strips are written to numbered files, outfile-0001.gif and" << endl
+       << "    so on. Arrows crossing between strips are only drawn in the later" << endl
+       << "    strip, cut off at its edge." << endl
+       << "--vcd-clock <signal>" << endl
+       << "    Input files named *.vcd are read as value change dumps. With this" << endl
+       << "    option each rising edge of the clock signal starts a new cycle." << endl
+       << "--vcd-period <time>" << endl
+       << "    Start a new cycle every <time> units of the dump's timescale." << endl
+       << "    Without either option each timestamp in the dump is a cycle." << endl
+       << "--vcd-scope <scope>" << endl
+       << "    Only read signals below the given scope, e.g. top.cpu." << endl
+       << "--vcd-signals <name>[,<name>...]" << endl
+       << "    Only read the named signals." << endl
+       << "--compile <file>" << endl
+       << "    Save the parsed diagram to a compiled file named *.dtb. Input files" << endl
+       << "    named *.dtb are loaded without parsing and must come first." << endl
+       << "--signals <pattern>[,<pattern>...]" << endl
+       << "    Only draw the signals whose names match one of the patterns, in" << endl
+       << "    which * matches any text and ? any single character." << endl
+       << "--exclude <pattern>[,<pattern>...]" << endl
+       << "    Leave out the signals whose names match one of the patterns." << endl
+       << "--from <cycle>" << endl
+       << "--to <cycle>" << endl
+       << "    Only draw the cycles from <cycle> up to but not including the --to" << endl
+       << "    cycle, counting from 0. Arrows leaving them are cut off at the edge." << endl
+       << "--viewport <x>,<y>,<w>,<h>" << endl
+       << "    Only draw the <w> by <h> pixel rectangle of the diagram whose top" << endl
+       << "    left corner is at <x>,<y>." << endl
+       << "--raster" << endl
+       << "    Draw PNG and PPM images with the built-in rasterizer and bitmap" << endl
+       << "    font instead of ImageMagick. It is much faster, but does not" << endl
+       << "    smooth edges. Builds without ImageMagick always use it." << endl
+       << "--threads <n>" << endl
+       << "    Draw images other than Postscript on <n> threads, each taking a band" << endl
+       << "    of signal rows. By default there is one thread per processor." << endl
        << "-a" << endl
        << "--aspect" << endl
        << "    Maintain fixed aspect ratio if --pagesize given." << endl
@@ -314,6 +882,10 @@ void usage (void) {
        << "-f" << endl
        << "--font-size" << endl
        << "    Font size (pt) [25]." << endl
+       << "--fit-text" << endl
+       << "    Shorten state labels which are wider than the cycles they are held." << endl
+       << "--metrics-cache <file>" << endl
+       << "    Keep the measured text widths in <file> between runs." << endl
        << "-l" << endl
        << "--line-width" << endl
        << "    Line width (pixels) [3]." << endl
@@ -0,0 +1,177 @@
+// This file is part of drawtiming.
+//
+// Drawtiming is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Drawtiming is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with drawtiming; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// A scanner for regular files which are mapped into memory.  It
+// accepts the same tokens as scanner.ll, but token texts point
+// straight into the mapping instead of being copied.
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+#include "parse.h"
+#include "parser.hh"
+#if defined (HAVE_SYS_MMAN_H) && defined (HAVE_MMAP)
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  define USE_MMAP 1
+#endif
+
+using namespace timing;
+
+#ifdef USE_MMAP
+namespace {
+
+  // the mapping is private and writable, so escapes in quoted text can
+  // be resolved in place.  Only pages which contain escapes get copied.
+  class mmap_lexer : public lexer {
+    char *p, *end;
+    int line;
+
+  public:
+    mmap_lexer (char *begin, char *e) : p (begin), end (e), line (1) { }
+    int lex (YYSTYPE *lval);
+    int lineno (void) { return line; }
+
+  private:
+    int quoted (YYSTYPE *lval, char close, int token);
+  };
+
+  // keeps the input mapped while it is being parsed
+  struct mapping {
+    void *addr;
+    size_t size;
+    mapping (void *a, size_t s) : addr (a), size (s) { }
+    ~mapping () { munmap (addr, size); }
+  };
+};
+
+// ------------------------------------------------------------
+
+static bool is_sym (char c) {
+  return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')
+    || (c >= '0' && c <= '9') || c == '_';
+}
+
+// ------------------------------------------------------------
+
+int mmap_lexer::lex (YYSTYPE *lval) {
+  // skip whitespace and comments
+  for (;;) {
+    if (p == end)
+      return 0;
+    if (*p == '\n')
+      ++ line;
+    else if (*p == '#') {
+      while (p != end && *p != '\n')
+	++ p;
+      continue;
+    }
+    else if (*p != ' ' && *p != '\t')
+      break;
+    ++ p;
+  }
+
+  char *start = p;
+  if (is_sym (*p)) {
+    // {SYM}(\.{SYM})*
+    for (;;) {
+      while (p != end && is_sym (*p))
+	++ p;
+      if (end - p < 2 || *p != '.' || !is_sym (p[1]))
+	break;
+      ++ p;
+    }
+    lval->text = start;
+    lval->len = p - start;
+    return SYMBOL;
+  }
+
+  ++ p;
+  switch (*start) {
+  case '"':
+    return quoted (lval, '"', STRING);
+  case '-':
+    return quoted (lval, '>', DELAY);
+  case '=':
+    if (p != end && *p == '>') {
+      ++ p;
+      return CAUSE;
+    }
+    break;
+  }
+  return *start;
+}
+
+// ------------------------------------------------------------
+
+int mmap_lexer::quoted (YYSTYPE *lval, char close, int token) {
+  // the text runs up to the closing character on the same line
+  char *start = p, *out = p;
+  while (p != end && *p != close) {
+    if (*p == '\n')
+      return -1;
+    if (*p == '\\' && end - p > 1 && p[1] != '\n')
+      ++ p;
+    if (out != p)
+      *out = *p;
+    ++ out;
+    ++ p;
+  }
+  if (p == end)
+    return -1;
+  ++ p;
+
+  lval->text = start;
+  lval->len = out - start;
+  return token;
+}
+#endif /* USE_MMAP */
+
+// ------------------------------------------------------------
+
+int timing::parse (const char *filename, parse_context &ctx) {
+#ifdef USE_MMAP
+  int fd = open (filename, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  // pipes, devices and empty files go through stdio
+  struct stat st;
+  void *addr = MAP_FAILED;
+  if (fstat (fd, &st) == 0 && S_ISREG (st.st_mode) && st.st_size > 0)
+    addr = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close (fd);
+
+  if (addr != MAP_FAILED) {
+    mapping m (addr, st.st_size);
+#ifdef MADV_SEQUENTIAL
+    madvise (addr, st.st_size, MADV_SEQUENTIAL);
+#endif
+    mmap_lexer lex ((char *) addr, (char *) addr + st.st_size);
+    return yyparse (lex, ctx);
+  }
+#endif /* USE_MMAP */
+
+  FILE *in = fopen (filename, "rt");
+  if (in == NULL)
+    return -1;
+  int result = parse (in, ctx);
+  fclose (in);
+  return result;
+}
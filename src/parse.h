@@ -0,0 +1,80 @@
+// -*- mode: c++; -*-
+// Copyright (c)2004 by Edward Counce, All rights reserved
+// This file is part of drawtiming.
+//
+// Drawtiming is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Drawtiming is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with drawtiming; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef __PARSE_H
+#define __PARSE_H
+#include "timing.h"
+#include <stdio.h>
+
+// token text, and the interned id once a statement names a signal.
+// The text is not copied; it stays valid until the end of the
+// timeslice the token belongs to.
+struct yystype {
+  const char *text;
+  unsigned len;
+  timing::sigid id;
+  std::string str (void) const { return std::string (text, len); }
+};
+#define YYSTYPE yystype
+
+namespace timing {
+
+  // a source of tokens for the grammar
+  class lexer {
+  public:
+    virtual ~lexer () { }
+    virtual int lex (YYSTYPE *lval) = 0;
+    virtual int lineno (void) = 0;
+  };
+
+  // the state of a parse in progress.  Successive files parsed with
+  // the same context continue from the timeslice the last one ended on.
+  struct parse_context {
+    data &tdata;
+    unsigned n;			// current timeslice
+    signal_sequence deps;	// signals the next "=>" depends on
+    parse_context (data &d) : tdata (d), n (0) { }
+    virtual ~parse_context () { }
+
+    // called each time a timeslice is complete, cycles before n are final
+    virtual void end_timeslice (void) { }
+  };
+
+  // parse one input file into ctx.tdata, returns 0 on success.  The
+  // file name version maps regular files into memory and scans them in
+  // place, and returns -1 with errno set if the file can't be opened.
+  int parse (FILE *in, parse_context &ctx);
+  int parse (const char *filename, parse_context &ctx);
+
+  // how simulation time in a value change dump becomes cycles: one per
+  // rising edge of the clock, one per period time units, or otherwise
+  // one per timestamp
+  struct vcd_options {
+    std::string clock;
+    unsigned long long period;
+    std::string scope;		// only read signals below this scope
+    std::vector<std::string> signals; // only these, by name or leaf name
+    vcd_options (void) : period (0) { }
+  };
+
+  // read a value change dump into ctx.tdata, returns like parse ()
+  int read_vcd (const char *filename, parse_context &ctx,
+		const vcd_options &opt);
+};
+
+#endif
@@ -20,14 +20,20 @@
 #ifdef HAVE_CONFIG_H
 #  include <config.h>
 #endif
-#include "globals.h"
-void yyerror (const char *s);
-extern int yylineno;
-int yylex (void);
+#include "parse.h"
 
 using namespace timing;
 %}
 
+%define api.pure full
+%lex-param {timing::lexer &lex}
+%parse-param {timing::lexer &lex} {timing::parse_context &ctx}
+
+%{
+static int yylex (YYSTYPE *lval, lexer &lex) { return lex.lex (lval); }
+void yyerror (lexer &lex, parse_context &ctx, const char *s);
+%}
+
 %token SYMBOL STRING CAUSE DELAY
 
 %%
@@ -37,24 +43,28 @@ timeslice
 | input timeslice;
 
 timeslice:
-'.' { ++ n; }
-| statements '.' { deps.clear (); ++ n; }
+'.' { ++ ctx.n; ctx.end_timeslice (); }
+| statements '.' { ctx.deps.clear (); ++ ctx.n; ctx.end_timeslice (); }
 
 statements:
-statement { $$ = $1; deps.push_back ($1); }
-| statements ',' statement { $$ = $3; deps.push_back ($3); }
-| statements ';' statement { $$ = $3; deps.clear (); deps.push_back ($3); }
-| statements CAUSE statement { $$ = $3; tdata.add_dependencies ($3, deps);
-    deps.clear (); deps.push_back ($3); }
-| statements DELAY statement { $$ = $3; tdata.add_delay ($3, $1, $2); }
+statement { $$ = $1; ctx.deps.push_back ($1.id); }
+| statements ',' statement { $$ = $3; ctx.deps.push_back ($3.id); }
+| statements ';' statement { $$ = $3; ctx.deps.clear (); ctx.deps.push_back ($3.id); }
+| statements CAUSE statement { $$ = $3; ctx.tdata.add_dependencies ($3.id, ctx.deps);
+    ctx.deps.clear (); ctx.deps.push_back ($3.id); }
+| statements DELAY statement { $$ = $3; ctx.tdata.add_delay ($3.id, $1.id, $2.str ()); }
 
 statement:
-SYMBOL '=' SYMBOL { $$ = $1; tdata.set_value ($1, n, timing::sigvalue ($3)); }
-| SYMBOL '=' STRING { $$ = $1; tdata.set_value ($1, n, timing::sigvalue ($3, timing::STATE)); }
-| SYMBOL { $$ = $1; };
+SYMBOL '=' SYMBOL { $$.id = ctx.tdata.signal_id ($1.text, $1.len);
+    if ($$.id != timing::no_signal)
+      ctx.tdata.set_value ($$.id, ctx.n, ctx.tdata.value ($3.text, $3.len, timing::UNDEF)); }
+| SYMBOL '=' STRING { $$.id = ctx.tdata.signal_id ($1.text, $1.len);
+    if ($$.id != timing::no_signal)
+      ctx.tdata.set_value ($$.id, ctx.n, ctx.tdata.value ($3.text, $3.len, timing::STATE)); }
+| SYMBOL { $$.id = ctx.tdata.signal_id ($1.text, $1.len); };
 
 %%
 
-void yyerror (const char *s) {
-  std::cerr << yylineno << ": " << s << std::endl;
+void yyerror (lexer &lex, parse_context &, const char *s) {
+  std::cerr << lex.lineno () << ": " << s << std::endl;
 }
@@ -0,0 +1,362 @@
+// This file is part of drawtiming.
+//
+// Drawtiming is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Drawtiming is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with drawtiming; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// PDF output.  Each page is written out as soon as it is complete:
+// its content stream, deflated if zlib is there, and then the page
+// object.  The objects which refer to all pages or fonts are left for
+// the end:
+//
+//   1  catalog
+//   2  page tree
+//   3  resources, a font dictionary shared by all pages
+//   4  and on, the content stream and page object of each page, and
+//      after them the fonts
+//
+// The content streams begin by turning the y axis downwards, so the
+// coordinates of the gc calls are used as they are.
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+#include "timing.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#if defined (HAVE_ZLIB_H) && defined (HAVE_LIBZ)
+#  include <zlib.h>
+#  define USE_ZLIB 1
+#endif
+
+using namespace timing;
+using namespace std;
+
+enum {CATALOG = 1, PAGE_TREE, RESOURCES, FIRST_FREE};
+
+// ------------------------------------------------------------
+// integers as such, anything else rounded to hundredths of a point
+
+static std::string num (double v) {
+  char buf[32];
+  if (v == floor (v) && fabs (v) < 1e15)
+    sprintf (buf, "%.0f", v);
+  else {
+    sprintf (buf, "%.2f", v);
+    size_t n = strlen (buf);
+    while (buf[n - 1] == '0')
+      buf[-- n] = 0;
+    if (buf[n - 1] == '.')
+      buf[-- n] = 0;
+  }
+  return buf;
+}
+
+static std::string rgb (unsigned color) {
+  return num ((color >> 16 & 0xff) / 255.0) + ' ' + num ((color >> 8 & 0xff) / 255.0)
+    + ' ' + num ((color & 0xff) / 255.0);
+}
+
+// ------------------------------------------------------------
+
+pdf_gc::pdf_gc (std::ostream &o)
+  : out (o), written (0), page_open (false), next_object (FIRST_FREE) {
+  state s;
+  s.filled = true;
+  s.font = "Helvetica";
+  s.point_size = 12;
+  states.push_back (s);
+  put ("%PDF-1.4\n%\xe2\xe3\xcf\xd3\n");
+}
+
+pdf_gc::~pdf_gc (void) {
+}
+
+// ------------------------------------------------------------
+
+void pdf_gc::put (const std::string &s) {
+  out.write (s.data (), s.size ());
+  written += s.size ();
+}
+
+void pdf_gc::begin_object (unsigned n) {
+  if (offsets.size () <= n)
+    offsets.resize (n + 1);
+  offsets[n] = written;
+  ostringstream head;
+  head << n << " 0 obj\n";
+  put (head.str ());
+}
+
+// ------------------------------------------------------------
+// where the drawing goes, once a page has been begun with its
+// background and the y axis flipped
+
+std::ostream &pdf_gc::content (void) {
+  if (!page_open) {
+    page_open = true;
+    page_width = width;
+    page_height = height;
+    contents.str (std::string ());
+    contents << "1 0 0 -1 0 " << height << " cm\n"
+	     << rgb (raster_gc::parse_color (vColor_Bg)) << " rg 0 0 "
+	     << width << ' ' << height << " re f\n0 g\n";
+  }
+  return contents;
+}
+
+// ------------------------------------------------------------
+
+void pdf_gc::end_page (void) {
+  if (!page_open)
+    return;
+  page_open = false;
+
+  std::string data = contents.str (), filter;
+#ifdef USE_ZLIB
+  uLongf size = compressBound (data.size ());
+  std::string packed (size, '\0');
+  if (compress2 ((Bytef *) &packed[0], &size, (const Bytef *) data.data (), data.size (),
+		 Z_BEST_COMPRESSION) == Z_OK) {
+    packed.resize (size);
+    data.swap (packed);
+    filter = " /Filter /FlateDecode";
+  }
+#endif /* USE_ZLIB */
+  contents.str (std::string ());
+
+  unsigned stream = next_object ++, page = next_object ++;
+  ostringstream obj;
+  begin_object (stream);
+  obj << "<< /Length " << data.size () << filter << " >>\nstream\n";
+  put (obj.str ());
+  put (data);
+  put ("\nendstream\nendobj\n");
+
+  begin_object (page);
+  obj.str (std::string ());
+  obj << "<< /Type /Page /Parent " << PAGE_TREE << " 0 R /MediaBox [0 0 "
+      << page_width << ' ' << page_height << "] /Resources " << RESOURCES
+      << " 0 R /Contents " << stream << " 0 R >>\nendobj\n";
+  put (obj.str ());
+  pages.push_back (page);
+}
+
+// ------------------------------------------------------------
+// the resource name of a font; all pages share them
+
+std::string pdf_gc::font_resource (const std::string &name) {
+  std::vector<std::string>::iterator i = find (fonts.begin (), fonts.end (), name);
+  ostringstream r;
+  r << "/F" << (i - fonts.begin ()) + 1;
+  if (i == fonts.end ())
+    fonts.push_back (name);
+  return r.str ();
+}
+
+// ------------------------------------------------------------
+
+void pdf_gc::path (const Magick::CoordinateList &points, const char *op) {
+  std::ostream &o = content ();
+  for (unsigned i = 0; i < points.size (); ++ i)
+    o << num (points[i].x ()) << ' ' << num (points[i].y ()) << (i ? " l " : " m ");
+  o << op << '\n';
+}
+
+// ------------------------------------------------------------
+
+void pdf_gc::bezier (const Magick::CoordinateList &points) {
+  if (points.empty ())
+    return;
+  std::ostream &o = content ();
+  o << num (points[0].x ()) << ' ' << num (points[0].y ()) << " m";
+  for (unsigned i = 1; i < points.size (); ++ i)
+    o << ' ' << num (points[i].x ()) << ' ' << num (points[i].y ()) << (i % 3 ? "" : " c");
+  o << " S\n";
+}
+
+// ------------------------------------------------------------
+
+void pdf_gc::fill_color (const std::string &name) {
+  states.back ().filled = strcasecmp (name.c_str (), "none") != 0;
+  if (states.back ().filled)
+    content () << rgb (raster_gc::parse_color (name)) << " rg\n";
+}
+
+// ------------------------------------------------------------
+
+void pdf_gc::fill_opacity (int op) {
+  if (op == 0)
+    states.back ().filled = false;
+}
+
+// ------------------------------------------------------------
+
+void pdf_gc::font (const std::string &name) {
+  states.back ().font = name;
+}
+
+// ------------------------------------------------------------
+
+void pdf_gc::line (int x1, int y1, int x2, int y2) {
+  content () << x1 << ' ' << y1 << " m " << x2 << ' ' << y2 << " l S\n";
+}
+
+void pdf_gc::polyline (const Magick::CoordinateList &points) {
+  path (points, "S");
+}
+
+void pdf_gc::drawrect (int x1, int y1, int x2, int y2) {
+  content () << min (x1, x2) << ' ' << min (y1, y2) << ' ' << abs (x2 - x1) << ' '
+	     << abs (y2 - y1) << " re " << (states.back ().filled ? "B" : "S") << '\n';
+}
+
+// ------------------------------------------------------------
+
+void pdf_gc::point_size (int size) {
+  states.back ().point_size = size;
+}
+
+// ------------------------------------------------------------
+
+void pdf_gc::polygon (const Magick::CoordinateList &points) {
+  path (points, states.back ().filled ? "h B" : "h S");
+}
+
+// ------------------------------------------------------------
+
+void pdf_gc::pop (void) {
+  if (states.size () > 1) {
+    states.pop_back ();
+    content () << "Q\n";
+  }
+}
+
+// ------------------------------------------------------------
+
+void pdf_gc::push (void) {
+  states.push_back (states.back ());
+  content () << "q\n";
+}
+
+// ------------------------------------------------------------
+
+void pdf_gc::scaling (double hscale, double vscale) {
+  content () << num (hscale) << " 0 0 " << num (vscale) << " 0 0 cm\n";
+}
+
+// ------------------------------------------------------------
+
+void pdf_gc::translate (double dx, double dy) {
+  content () << "1 0 0 1 " << num (dx) << ' ' << num (dy) << " cm\n";
+}
+
+// ------------------------------------------------------------
+
+void pdf_gc::stroke_color (const std::string &name) {
+  content () << rgb (raster_gc::parse_color (name)) << " RG\n";
+}
+
+// ------------------------------------------------------------
+
+void pdf_gc::stroke_width (int w) {
+  content () << w << " w\n";
+}
+
+// ------------------------------------------------------------
+// the text matrix turns the glyphs upright again
+
+void pdf_gc::text (int x, int y, const std::string &text) {
+  const state &s = states.back ();
+  std::ostream &o = content ();
+  o << "BT " << font_resource (s.font) << ' ' << s.point_size << " Tf 1 0 0 -1 "
+    << x << ' ' << y << " Tm (";
+  for (std::string::size_type i = 0; i < text.size (); ++ i) {
+    if (text[i] == '(' || text[i] == ')' || text[i] == '\\')
+      o << '\\';
+    o << text[i];
+  }
+  o << ") Tj ET\n";
+}
+
+// ------------------------------------------------------------
+
+void pdf_gc::page (void) {
+  end_page ();
+}
+
+// ------------------------------------------------------------
+
+void pdf_gc::finish (void) {
+  if (pages.empty ())
+    content ();
+  end_page ();
+
+  ostringstream obj;
+  for (unsigned i = 0; i < fonts.size (); ++ i) {
+    begin_object (next_object + i);
+    obj.str (std::string ());
+    obj << "<< /Type /Font /Subtype /Type1 /BaseFont /";
+    for (std::string::size_type k = 0; k < fonts[i].size (); ++ k)
+      if (fonts[i][k] == ' ')
+	obj << "#20";
+      else
+	obj << fonts[i][k];
+    obj << " /Encoding /WinAnsiEncoding >>\nendobj\n";
+    put (obj.str ());
+  }
+
+  begin_object (RESOURCES);
+  obj.str (std::string ());
+  obj << "<< /Font <<";
+  for (unsigned i = 0; i < fonts.size (); ++ i)
+    obj << " /F" << i + 1 << ' ' << next_object + i << " 0 R";
+  obj << " >> >>\nendobj\n";
+  put (obj.str ());
+  next_object += fonts.size ();
+
+  begin_object (PAGE_TREE);
+  obj.str (std::string ());
+  obj << "<< /Type /Pages /Count " << pages.size () << " /Kids [";
+  for (unsigned i = 0; i < pages.size (); ++ i)
+    obj << (i ? " " : "") << pages[i] << " 0 R";
+  obj << "] >>\nendobj\n";
+  put (obj.str ());
+
+  begin_object (CATALOG);
+  obj.str (std::string ());
+  obj << "<< /Type /Catalog /Pages " << PAGE_TREE << " 0 R >>\nendobj\n";
+  put (obj.str ());
+
+  std::streamoff xref = written;
+  obj.str (std::string ());
+  obj << "xref\n0 " << next_object << "\n0000000000 65535 f \n";
+  for (unsigned i = 1; i < next_object; ++ i) {
+    char entry[32];
+    sprintf (entry, "%010lu 00000 n \n", (unsigned long) offsets[i]);
+    obj << entry;
+  }
+  obj << "trailer\n<< /Size " << next_object << " /Root " << CATALOG
+      << " 0 R >>\nstartxref\n" << xref << "\n%%EOF\n";
+  put (obj.str ());
+}
+
+// ------------------------------------------------------------
+
+bool pdf_gc::has_pdf_ext (const std::string &filename) {
+  std::string::size_type dot = filename.rfind ('.');
+  return dot != std::string::npos && !strcasecmp (filename.c_str () + dot + 1, "pdf");
+}
@@ -0,0 +1,794 @@
+// This file is part of drawtiming.
+//
+// Drawtiming is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Drawtiming is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with drawtiming; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// The built-in rasterizer: everything is filled as horizontal spans of
+// 0xrrggbb pixels, without antialiasing.  As in ImageMagick the centre
+// of pixel (i, j) is at (i, j), and a span covers the pixels whose
+// centres lie in [x0, x1).  Text uses a 5x7 bitmap font, each dot of
+// which becomes a filled rectangle.
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+#include "timing.h"
+#include <fstream>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#if defined (HAVE_ZLIB_H) && defined (HAVE_LIBZ)
+#  include <zlib.h>
+#  define USE_ZLIB 1
+#endif
+
+using namespace timing;
+using namespace std;
+
+// ------------------------------------------------------------
+// printable ASCII from ' ' to '~', five columns each, with the top
+// row in the low bit
+
+static const unsigned char glyphs[][5] = {
+  {0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5f,0x00,0x00}, // space !
+  {0x00,0x07,0x00,0x07,0x00}, {0x14,0x7f,0x14,0x7f,0x14}, // " #
+  {0x24,0x2a,0x7f,0x2a,0x12}, {0x23,0x13,0x08,0x64,0x62}, // $ %
+  {0x36,0x49,0x55,0x22,0x50}, {0x00,0x05,0x03,0x00,0x00}, // & '
+  {0x00,0x1c,0x22,0x41,0x00}, {0x00,0x41,0x22,0x1c,0x00}, // ( )
+  {0x08,0x2a,0x1c,0x2a,0x08}, {0x08,0x08,0x3e,0x08,0x08}, // * +
+  {0x00,0x50,0x30,0x00,0x00}, {0x08,0x08,0x08,0x08,0x08}, // , -
+  {0x00,0x60,0x60,0x00,0x00}, {0x20,0x10,0x08,0x04,0x02}, // . /
+  {0x3e,0x51,0x49,0x45,0x3e}, {0x00,0x42,0x7f,0x40,0x00}, // 0 1
+  {0x42,0x61,0x51,0x49,0x46}, {0x21,0x41,0x45,0x4b,0x31}, // 2 3
+  {0x18,0x14,0x12,0x7f,0x10}, {0x27,0x45,0x45,0x45,0x39}, // 4 5
+  {0x3c,0x4a,0x49,0x49,0x30}, {0x01,0x71,0x09,0x05,0x03}, // 6 7
+  {0x36,0x49,0x49,0x49,0x36}, {0x06,0x49,0x49,0x29,0x1e}, // 8 9
+  {0x00,0x36,0x36,0x00,0x00}, {0x00,0x56,0x36,0x00,0x00}, // : ;
+  {0x08,0x14,0x22,0x41,0x00}, {0x14,0x14,0x14,0x14,0x14}, // < =
+  {0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x51,0x09,0x06}, // > ?
+  {0x32,0x49,0x79,0x41,0x3e}, {0x7e,0x11,0x11,0x11,0x7e}, // @ A
+  {0x7f,0x49,0x49,0x49,0x36}, {0x3e,0x41,0x41,0x41,0x22}, // B C
+  {0x7f,0x41,0x41,0x22,0x1c}, {0x7f,0x49,0x49,0x49,0x41}, // D E
+  {0x7f,0x09,0x09,0x01,0x01}, {0x3e,0x41,0x41,0x51,0x32}, // F G
+  {0x7f,0x08,0x08,0x08,0x7f}, {0x00,0x41,0x7f,0x41,0x00}, // H I
+  {0x20,0x40,0x41,0x3f,0x01}, {0x7f,0x08,0x14,0x22,0x41}, // J K
+  {0x7f,0x40,0x40,0x40,0x40}, {0x7f,0x02,0x04,0x02,0x7f}, // L M
+  {0x7f,0x04,0x08,0x10,0x7f}, {0x3e,0x41,0x41,0x41,0x3e}, // N O
+  {0x7f,0x09,0x09,0x09,0x06}, {0x3e,0x41,0x51,0x21,0x5e}, // P Q
+  {0x7f,0x09,0x19,0x29,0x46}, {0x46,0x49,0x49,0x49,0x31}, // R S
+  {0x01,0x01,0x7f,0x01,0x01}, {0x3f,0x40,0x40,0x40,0x3f}, // T U
+  {0x1f,0x20,0x40,0x20,0x1f}, {0x7f,0x20,0x18,0x20,0x7f}, // V W
+  {0x63,0x14,0x08,0x14,0x63}, {0x03,0x04,0x78,0x04,0x03}, // X Y
+  {0x61,0x51,0x49,0x45,0x43}, {0x00,0x7f,0x41,0x41,0x00}, // Z [
+  {0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x7f,0x00}, // \ ]
+  {0x04,0x02,0x01,0x02,0x04}, {0x40,0x40,0x40,0x40,0x40}, // ^ _
+  {0x00,0x01,0x02,0x04,0x00}, {0x20,0x54,0x54,0x54,0x78}, // ` a
+  {0x7f,0x48,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x20}, // b c
+  {0x38,0x44,0x44,0x48,0x7f}, {0x38,0x54,0x54,0x54,0x18}, // d e
+  {0x08,0x7e,0x09,0x01,0x02}, {0x0c,0x52,0x52,0x52,0x3e}, // f g
+  {0x7f,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7d,0x40,0x00}, // h i
+  {0x20,0x40,0x44,0x3d,0x00}, {0x00,0x7f,0x10,0x28,0x44}, // j k
+  {0x00,0x41,0x7f,0x40,0x00}, {0x7c,0x04,0x18,0x04,0x78}, // l m
+  {0x7c,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38}, // n o
+  {0x7c,0x14,0x14,0x14,0x08}, {0x08,0x14,0x14,0x18,0x7c}, // p q
+  {0x7c,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x20}, // r s
+  {0x04,0x3f,0x44,0x40,0x20}, {0x3c,0x40,0x40,0x20,0x7c}, // t u
+  {0x1c,0x20,0x40,0x20,0x1c}, {0x3c,0x40,0x30,0x40,0x3c}, // v w
+  {0x44,0x28,0x10,0x28,0x44}, {0x0c,0x50,0x50,0x50,0x3c}, // x y
+  {0x44,0x64,0x54,0x4c,0x44}, {0x00,0x08,0x36,0x41,0x00}, // z {
+  {0x00,0x00,0x7f,0x00,0x00}, {0x00,0x41,0x36,0x08,0x00}, // | }
+  {0x02,0x01,0x02,0x04,0x02}				  // ~
+};
+
+// a glyph cell is six dots wide with the gap, and eight high with the
+// descender; the cell is sized to match the width vMetrics gives
+// texts in the lite build
+static const double glyph_advance = 0.7;
+
+// ------------------------------------------------------------
+
+namespace {
+  struct named_color {
+    const char *name;
+    unsigned rgb;
+  };
+};
+
+// the SVG colour names, and the X11 ones ImageMagick knows as well,
+// with the SVG value where both have a name; sorted for bsearch.  The
+// X11 grays 0 to 100 are computed, see parse_color.
+static const named_color colors[] = {
+  {"aliceblue", 0xf0f8ff}, {"antiquewhite", 0xfaebd7},
+  {"antiquewhite1", 0xffefdb}, {"antiquewhite2", 0xeedfcc},
+  {"antiquewhite3", 0xcdc0b0}, {"antiquewhite4", 0x8b8378},
+  {"aqua", 0x00ffff}, {"aquamarine", 0x7fffd4}, {"aquamarine1", 0x7fffd4},
+  {"aquamarine2", 0x76eec6}, {"aquamarine3", 0x66cdaa},
+  {"aquamarine4", 0x458b74}, {"azure", 0xf0ffff}, {"azure1", 0xf0ffff},
+  {"azure2", 0xe0eeee}, {"azure3", 0xc1cdcd}, {"azure4", 0x838b8b},
+  {"beige", 0xf5f5dc}, {"bisque", 0xffe4c4}, {"bisque1", 0xffe4c4},
+  {"bisque2", 0xeed5b7}, {"bisque3", 0xcdb79e}, {"bisque4", 0x8b7d6b},
+  {"black", 0x000000}, {"blanchedalmond", 0xffebcd}, {"blue", 0x0000ff},
+  {"blue1", 0x0000ff}, {"blue2", 0x0000ee}, {"blue3", 0x0000cd},
+  {"blue4", 0x00008b}, {"blueviolet", 0x8a2be2}, {"brown", 0xa52a2a},
+  {"brown1", 0xff4040}, {"brown2", 0xee3b3b}, {"brown3", 0xcd3333},
+  {"brown4", 0x8b2323}, {"burlywood", 0xdeb887}, {"burlywood1", 0xffd39b},
+  {"burlywood2", 0xeec591}, {"burlywood3", 0xcdaa7d},
+  {"burlywood4", 0x8b7355}, {"cadetblue", 0x5f9ea0}, {"cadetblue1", 0x98f5ff},
+  {"cadetblue2", 0x8ee5ee}, {"cadetblue3", 0x7ac5cd},
+  {"cadetblue4", 0x53868b}, {"chartreuse", 0x7fff00},
+  {"chartreuse1", 0x7fff00}, {"chartreuse2", 0x76ee00},
+  {"chartreuse3", 0x66cd00}, {"chartreuse4", 0x458b00},
+  {"chocolate", 0xd2691e}, {"chocolate1", 0xff7f24}, {"chocolate2", 0xee7621},
+  {"chocolate3", 0xcd661d}, {"chocolate4", 0x8b4513}, {"coral", 0xff7f50},
+  {"coral1", 0xff7256}, {"coral2", 0xee6a50}, {"coral3", 0xcd5b45},
+  {"coral4", 0x8b3e2f}, {"cornflowerblue", 0x6495ed}, {"cornsilk", 0xfff8dc},
+  {"cornsilk1", 0xfff8dc}, {"cornsilk2", 0xeee8cd}, {"cornsilk3", 0xcdc8b1},
+  {"cornsilk4", 0x8b8878}, {"crimson", 0xdc143c}, {"cyan", 0x00ffff},
+  {"cyan1", 0x00ffff}, {"cyan2", 0x00eeee}, {"cyan3", 0x00cdcd},
+  {"cyan4", 0x008b8b}, {"darkblue", 0x00008b}, {"darkcyan", 0x008b8b},
+  {"darkgoldenrod", 0xb8860b}, {"darkgoldenrod1", 0xffb90f},
+  {"darkgoldenrod2", 0xeead0e}, {"darkgoldenrod3", 0xcd950c},
+  {"darkgoldenrod4", 0x8b6508}, {"darkgray", 0xa9a9a9},
+  {"darkgreen", 0x006400}, {"darkgrey", 0xa9a9a9}, {"darkkhaki", 0xbdb76b},
+  {"darkmagenta", 0x8b008b}, {"darkolivegreen", 0x556b2f},
+  {"darkolivegreen1", 0xcaff70}, {"darkolivegreen2", 0xbcee68},
+  {"darkolivegreen3", 0xa2cd5a}, {"darkolivegreen4", 0x6e8b3d},
+  {"darkorange", 0xff8c00}, {"darkorange1", 0xff7f00},
+  {"darkorange2", 0xee7600}, {"darkorange3", 0xcd6600},
+  {"darkorange4", 0x8b4500}, {"darkorchid", 0x9932cc},
+  {"darkorchid1", 0xbf3eff}, {"darkorchid2", 0xb23aee},
+  {"darkorchid3", 0x9a32cd}, {"darkorchid4", 0x68228b}, {"darkred", 0x8b0000},
+  {"darksalmon", 0xe9967a}, {"darkseagreen", 0x8fbc8f},
+  {"darkseagreen1", 0xc1ffc1}, {"darkseagreen2", 0xb4eeb4},
+  {"darkseagreen3", 0x9bcd9b}, {"darkseagreen4", 0x698b69},
+  {"darkslateblue", 0x483d8b}, {"darkslategray", 0x2f4f4f},
+  {"darkslategray1", 0x97ffff}, {"darkslategray2", 0x8deeee},
+  {"darkslategray3", 0x79cdcd}, {"darkslategray4", 0x528b8b},
+  {"darkslategrey", 0x2f4f4f}, {"darkturquoise", 0x00ced1},
+  {"darkviolet", 0x9400d3}, {"debianred", 0xd70751}, {"deeppink", 0xff1493},
+  {"deeppink1", 0xff1493}, {"deeppink2", 0xee1289}, {"deeppink3", 0xcd1076},
+  {"deeppink4", 0x8b0a50}, {"deepskyblue", 0x00bfff},
+  {"deepskyblue1", 0x00bfff}, {"deepskyblue2", 0x00b2ee},
+  {"deepskyblue3", 0x009acd}, {"deepskyblue4", 0x00688b},
+  {"dimgray", 0x696969}, {"dimgrey", 0x696969}, {"dodgerblue", 0x1e90ff},
+  {"dodgerblue1", 0x1e90ff}, {"dodgerblue2", 0x1c86ee},
+  {"dodgerblue3", 0x1874cd}, {"dodgerblue4", 0x104e8b},
+  {"firebrick", 0xb22222}, {"firebrick1", 0xff3030}, {"firebrick2", 0xee2c2c},
+  {"firebrick3", 0xcd2626}, {"firebrick4", 0x8b1a1a},
+  {"floralwhite", 0xfffaf0}, {"forestgreen", 0x228b22}, {"fuchsia", 0xff00ff},
+  {"gainsboro", 0xdcdcdc}, {"ghostwhite", 0xf8f8ff}, {"gold", 0xffd700},
+  {"gold1", 0xffd700}, {"gold2", 0xeec900}, {"gold3", 0xcdad00},
+  {"gold4", 0x8b7500}, {"goldenrod", 0xdaa520}, {"goldenrod1", 0xffc125},
+  {"goldenrod2", 0xeeb422}, {"goldenrod3", 0xcd9b1d},
+  {"goldenrod4", 0x8b6914}, {"gray", 0x808080}, {"green", 0x008000},
+  {"green1", 0x00ff00}, {"green2", 0x00ee00}, {"green3", 0x00cd00},
+  {"green4", 0x008b00}, {"greenyellow", 0xadff2f}, {"grey", 0x808080},
+  {"honeydew", 0xf0fff0}, {"honeydew1", 0xf0fff0}, {"honeydew2", 0xe0eee0},
+  {"honeydew3", 0xc1cdc1}, {"honeydew4", 0x838b83}, {"hotpink", 0xff69b4},
+  {"hotpink1", 0xff6eb4}, {"hotpink2", 0xee6aa7}, {"hotpink3", 0xcd6090},
+  {"hotpink4", 0x8b3a62}, {"indianred", 0xcd5c5c}, {"indianred1", 0xff6a6a},
+  {"indianred2", 0xee6363}, {"indianred3", 0xcd5555},
+  {"indianred4", 0x8b3a3a}, {"indigo", 0x4b0082}, {"ivory", 0xfffff0},
+  {"ivory1", 0xfffff0}, {"ivory2", 0xeeeee0}, {"ivory3", 0xcdcdc1},
+  {"ivory4", 0x8b8b83}, {"khaki", 0xf0e68c}, {"khaki1", 0xfff68f},
+  {"khaki2", 0xeee685}, {"khaki3", 0xcdc673}, {"khaki4", 0x8b864e},
+  {"lavender", 0xe6e6fa}, {"lavenderblush", 0xfff0f5},
+  {"lavenderblush1", 0xfff0f5}, {"lavenderblush2", 0xeee0e5},
+  {"lavenderblush3", 0xcdc1c5}, {"lavenderblush4", 0x8b8386},
+  {"lawngreen", 0x7cfc00}, {"lemonchiffon", 0xfffacd},
+  {"lemonchiffon1", 0xfffacd}, {"lemonchiffon2", 0xeee9bf},
+  {"lemonchiffon3", 0xcdc9a5}, {"lemonchiffon4", 0x8b8970},
+  {"lightblue", 0xadd8e6}, {"lightblue1", 0xbfefff}, {"lightblue2", 0xb2dfee},
+  {"lightblue3", 0x9ac0cd}, {"lightblue4", 0x68838b},
+  {"lightcoral", 0xf08080}, {"lightcyan", 0xe0ffff}, {"lightcyan1", 0xe0ffff},
+  {"lightcyan2", 0xd1eeee}, {"lightcyan3", 0xb4cdcd},
+  {"lightcyan4", 0x7a8b8b}, {"lightgoldenrod", 0xeedd82},
+  {"lightgoldenrod1", 0xffec8b}, {"lightgoldenrod2", 0xeedc82},
+  {"lightgoldenrod3", 0xcdbe70}, {"lightgoldenrod4", 0x8b814c},
+  {"lightgoldenrodyellow", 0xfafad2}, {"lightgray", 0xd3d3d3},
+  {"lightgreen", 0x90ee90}, {"lightgrey", 0xd3d3d3}, {"lightpink", 0xffb6c1},
+  {"lightpink1", 0xffaeb9}, {"lightpink2", 0xeea2ad},
+  {"lightpink3", 0xcd8c95}, {"lightpink4", 0x8b5f65},
+  {"lightsalmon", 0xffa07a}, {"lightsalmon1", 0xffa07a},
+  {"lightsalmon2", 0xee9572}, {"lightsalmon3", 0xcd8162},
+  {"lightsalmon4", 0x8b5742}, {"lightseagreen", 0x20b2aa},
+  {"lightskyblue", 0x87cefa}, {"lightskyblue1", 0xb0e2ff},
+  {"lightskyblue2", 0xa4d3ee}, {"lightskyblue3", 0x8db6cd},
+  {"lightskyblue4", 0x607b8b}, {"lightslateblue", 0x8470ff},
+  {"lightslategray", 0x778899}, {"lightslategrey", 0x778899},
+  {"lightsteelblue", 0xb0c4de}, {"lightsteelblue1", 0xcae1ff},
+  {"lightsteelblue2", 0xbcd2ee}, {"lightsteelblue3", 0xa2b5cd},
+  {"lightsteelblue4", 0x6e7b8b}, {"lightyellow", 0xffffe0},
+  {"lightyellow1", 0xffffe0}, {"lightyellow2", 0xeeeed1},
+  {"lightyellow3", 0xcdcdb4}, {"lightyellow4", 0x8b8b7a}, {"lime", 0x00ff00},
+  {"limegreen", 0x32cd32}, {"linen", 0xfaf0e6}, {"magenta", 0xff00ff},
+  {"magenta1", 0xff00ff}, {"magenta2", 0xee00ee}, {"magenta3", 0xcd00cd},
+  {"magenta4", 0x8b008b}, {"maroon", 0x800000}, {"maroon1", 0xff34b3},
+  {"maroon2", 0xee30a7}, {"maroon3", 0xcd2990}, {"maroon4", 0x8b1c62},
+  {"mediumaquamarine", 0x66cdaa}, {"mediumblue", 0x0000cd},
+  {"mediumorchid", 0xba55d3}, {"mediumorchid1", 0xe066ff},
+  {"mediumorchid2", 0xd15fee}, {"mediumorchid3", 0xb452cd},
+  {"mediumorchid4", 0x7a378b}, {"mediumpurple", 0x9370db},
+  {"mediumpurple1", 0xab82ff}, {"mediumpurple2", 0x9f79ee},
+  {"mediumpurple3", 0x8968cd}, {"mediumpurple4", 0x5d478b},
+  {"mediumseagreen", 0x3cb371}, {"mediumslateblue", 0x7b68ee},
+  {"mediumspringgreen", 0x00fa9a}, {"mediumturquoise", 0x48d1cc},
+  {"mediumvioletred", 0xc71585}, {"midnightblue", 0x191970},
+  {"mintcream", 0xf5fffa}, {"mistyrose", 0xffe4e1}, {"mistyrose1", 0xffe4e1},
+  {"mistyrose2", 0xeed5d2}, {"mistyrose3", 0xcdb7b5},
+  {"mistyrose4", 0x8b7d7b}, {"moccasin", 0xffe4b5}, {"navajowhite", 0xffdead},
+  {"navajowhite1", 0xffdead}, {"navajowhite2", 0xeecfa1},
+  {"navajowhite3", 0xcdb38b}, {"navajowhite4", 0x8b795e}, {"navy", 0x000080},
+  {"navyblue", 0x000080}, {"oldlace", 0xfdf5e6}, {"olive", 0x808000},
+  {"olivedrab", 0x6b8e23}, {"olivedrab1", 0xc0ff3e}, {"olivedrab2", 0xb3ee3a},
+  {"olivedrab3", 0x9acd32}, {"olivedrab4", 0x698b22}, {"orange", 0xffa500},
+  {"orange1", 0xffa500}, {"orange2", 0xee9a00}, {"orange3", 0xcd8500},
+  {"orange4", 0x8b5a00}, {"orangered", 0xff4500}, {"orangered1", 0xff4500},
+  {"orangered2", 0xee4000}, {"orangered3", 0xcd3700},
+  {"orangered4", 0x8b2500}, {"orchid", 0xda70d6}, {"orchid1", 0xff83fa},
+  {"orchid2", 0xee7ae9}, {"orchid3", 0xcd69c9}, {"orchid4", 0x8b4789},
+  {"palegoldenrod", 0xeee8aa}, {"palegreen", 0x98fb98},
+  {"palegreen1", 0x9aff9a}, {"palegreen2", 0x90ee90},
+  {"palegreen3", 0x7ccd7c}, {"palegreen4", 0x548b54},
+  {"paleturquoise", 0xafeeee}, {"paleturquoise1", 0xbbffff},
+  {"paleturquoise2", 0xaeeeee}, {"paleturquoise3", 0x96cdcd},
+  {"paleturquoise4", 0x668b8b}, {"palevioletred", 0xdb7093},
+  {"palevioletred1", 0xff82ab}, {"palevioletred2", 0xee799f},
+  {"palevioletred3", 0xcd6889}, {"palevioletred4", 0x8b475d},
+  {"papayawhip", 0xffefd5}, {"peachpuff", 0xffdab9}, {"peachpuff1", 0xffdab9},
+  {"peachpuff2", 0xeecbad}, {"peachpuff3", 0xcdaf95},
+  {"peachpuff4", 0x8b7765}, {"peru", 0xcd853f}, {"pink", 0xffc0cb},
+  {"pink1", 0xffb5c5}, {"pink2", 0xeea9b8}, {"pink3", 0xcd919e},
+  {"pink4", 0x8b636c}, {"plum", 0xdda0dd}, {"plum1", 0xffbbff},
+  {"plum2", 0xeeaeee}, {"plum3", 0xcd96cd}, {"plum4", 0x8b668b},
+  {"powderblue", 0xb0e0e6}, {"purple", 0x800080}, {"purple1", 0x9b30ff},
+  {"purple2", 0x912cee}, {"purple3", 0x7d26cd}, {"purple4", 0x551a8b},
+  {"red", 0xff0000}, {"red1", 0xff0000}, {"red2", 0xee0000},
+  {"red3", 0xcd0000}, {"red4", 0x8b0000}, {"rosybrown", 0xbc8f8f},
+  {"rosybrown1", 0xffc1c1}, {"rosybrown2", 0xeeb4b4},
+  {"rosybrown3", 0xcd9b9b}, {"rosybrown4", 0x8b6969}, {"royalblue", 0x4169e1},
+  {"royalblue1", 0x4876ff}, {"royalblue2", 0x436eee},
+  {"royalblue3", 0x3a5fcd}, {"royalblue4", 0x27408b},
+  {"saddlebrown", 0x8b4513}, {"salmon", 0xfa8072}, {"salmon1", 0xff8c69},
+  {"salmon2", 0xee8262}, {"salmon3", 0xcd7054}, {"salmon4", 0x8b4c39},
+  {"sandybrown", 0xf4a460}, {"seagreen", 0x2e8b57}, {"seagreen1", 0x54ff9f},
+  {"seagreen2", 0x4eee94}, {"seagreen3", 0x43cd80}, {"seagreen4", 0x2e8b57},
+  {"seashell", 0xfff5ee}, {"seashell1", 0xfff5ee}, {"seashell2", 0xeee5de},
+  {"seashell3", 0xcdc5bf}, {"seashell4", 0x8b8682}, {"sienna", 0xa0522d},
+  {"sienna1", 0xff8247}, {"sienna2", 0xee7942}, {"sienna3", 0xcd6839},
+  {"sienna4", 0x8b4726}, {"silver", 0xc0c0c0}, {"skyblue", 0x87ceeb},
+  {"skyblue1", 0x87ceff}, {"skyblue2", 0x7ec0ee}, {"skyblue3", 0x6ca6cd},
+  {"skyblue4", 0x4a708b}, {"slateblue", 0x6a5acd}, {"slateblue1", 0x836fff},
+  {"slateblue2", 0x7a67ee}, {"slateblue3", 0x6959cd},
+  {"slateblue4", 0x473c8b}, {"slategray", 0x708090}, {"slategray1", 0xc6e2ff},
+  {"slategray2", 0xb9d3ee}, {"slategray3", 0x9fb6cd},
+  {"slategray4", 0x6c7b8b}, {"slategrey", 0x708090}, {"snow", 0xfffafa},
+  {"snow1", 0xfffafa}, {"snow2", 0xeee9e9}, {"snow3", 0xcdc9c9},
+  {"snow4", 0x8b8989}, {"springgreen", 0x00ff7f}, {"springgreen1", 0x00ff7f},
+  {"springgreen2", 0x00ee76}, {"springgreen3", 0x00cd66},
+  {"springgreen4", 0x008b45}, {"steelblue", 0x4682b4},
+  {"steelblue1", 0x63b8ff}, {"steelblue2", 0x5cacee},
+  {"steelblue3", 0x4f94cd}, {"steelblue4", 0x36648b}, {"tan", 0xd2b48c},
+  {"tan1", 0xffa54f}, {"tan2", 0xee9a49}, {"tan3", 0xcd853f},
+  {"tan4", 0x8b5a2b}, {"teal", 0x008080}, {"thistle", 0xd8bfd8},
+  {"thistle1", 0xffe1ff}, {"thistle2", 0xeed2ee}, {"thistle3", 0xcdb5cd},
+  {"thistle4", 0x8b7b8b}, {"tomato", 0xff6347}, {"tomato1", 0xff6347},
+  {"tomato2", 0xee5c42}, {"tomato3", 0xcd4f39}, {"tomato4", 0x8b3626},
+  {"turquoise", 0x40e0d0}, {"turquoise1", 0x00f5ff}, {"turquoise2", 0x00e5ee},
+  {"turquoise3", 0x00c5cd}, {"turquoise4", 0x00868b}, {"violet", 0xee82ee},
+  {"violetred", 0xd02090}, {"violetred1", 0xff3e96}, {"violetred2", 0xee3a8c},
+  {"violetred3", 0xcd3278}, {"violetred4", 0x8b2252}, {"wheat", 0xf5deb3},
+  {"wheat1", 0xffe7ba}, {"wheat2", 0xeed8ae}, {"wheat3", 0xcdba96},
+  {"wheat4", 0x8b7e66}, {"white", 0xffffff}, {"whitesmoke", 0xf5f5f5},
+  {"yellow", 0xffff00}, {"yellow1", 0xffff00}, {"yellow2", 0xeeee00},
+  {"yellow3", 0xcdcd00}, {"yellow4", 0x8b8b00}, {"yellowgreen", 0x9acd32}
+};
+
+static int compare_color (const void *name, const void *entry) {
+  return strcasecmp ((const char *) name, ((const named_color *) entry)->name);
+}
+
+// "#rgb", "#rrggbb", "gray0" to "gray100" or one of the names above.
+// "none" only turns filling off, see fill_color.
+unsigned raster_gc::parse_color (const std::string &name) {
+  const char *s = name.c_str ();
+  if (s[0] == '#') {
+    size_t n = strspn (s + 1, "0123456789abcdefABCDEF");
+    if (s[n + 1] == '\0' && (n == 3 || n == 6)) {
+      unsigned v = strtoul (s + 1, NULL, 16);
+      if (n == 3)
+	v = ((v & 0xf00) << 12 | (v & 0xf0) << 8 | (v & 0xf) << 4) * 0x11 / 0x10;
+      return v;
+    }
+  }
+  else if (!strcasecmp (s, "none"))
+    return 0;
+  else if ((!strncasecmp (s, "gray", 4) || !strncasecmp (s, "grey", 4))
+	   && s[4] && strlen (s + 4) <= 3
+	   && strspn (s + 4, "0123456789") == strlen (s + 4) && atoi (s + 4) <= 100)
+    return (unsigned) (atoi (s + 4) * 2.55 + 0.5) * 0x010101;
+  else {
+    const named_color *c = (const named_color *)
+      bsearch (s, colors, sizeof (colors) / sizeof (colors[0]), sizeof (colors[0]),
+	       compare_color);
+    if (c != NULL)
+      return c->rgb;
+  }
+  throw bad_color (name);
+}
+
+// ------------------------------------------------------------
+
+raster_gc::raster_gc (void) : recording (NULL), stamp_x (0), stamp_y (0) {
+  state s;
+  s.sx = s.sy = 1;
+  s.tx = s.ty = 0;
+  s.stroke = s.fill = 0;
+  s.filled = true;
+  s.stroke_width = s.point_size = 1;
+  states.push_back (s);
+}
+
+raster_gc::~raster_gc (void) {
+}
+
+// ------------------------------------------------------------
+// the canvas is only allocated once render() has set its size
+
+unsigned *raster_gc::canvas (void) {
+  if (pixels.empty () && width > 0 && height > 0)
+    pixels.assign ((size_t) width * height, parse_color (vColor_Bg));
+  return pixels.empty () ? NULL : &pixels[0];
+}
+
+Magick::Coordinate raster_gc::map (double x, double y) const {
+  const state &s = states.back ();
+  return Magick::Coordinate (s.sx * x + s.tx, s.sy * y + s.ty);
+}
+
+// ------------------------------------------------------------
+
+// the first pixel whose centre lies at or after v.  Rounding errors
+// are forgiven, so that a drawing moved by whole pixels, as with a
+// viewport, covers the same pixels.
+
+static int edge (double v) {
+  return (int) ceil (v - 1e-6);
+}
+
+void raster_gc::span (int y, double x0, double x1, unsigned color) {
+  unsigned *p = canvas ();
+  int a = edge (x0), b = edge (x1);
+  if (recording && a < b) {
+    stamp_run r = {y - stamp_y, a - stamp_x, b - stamp_x, color};
+    recording->push_back (r);
+  }
+  if (p == NULL || y < 0 || y >= height)
+    return;
+  a = max (0, a);
+  b = min (width, b);
+  if (a < b)
+    fill_n (p + (size_t) y * width + a, b - a, color);
+}
+
+// While a stamp is recorded, rows off the canvas are kept in it too:
+// the same shape may be stamped later where the whole of it shows.
+
+void raster_gc::fill_rect (double x0, double y0, double x1, double y1, unsigned color) {
+  int a = edge (min (y0, y1)), b = edge (max (y0, y1));
+  if (!recording) {
+    a = max (0, a);
+    b = min (height, b);
+  }
+  for (int y = a; y < b; ++ y)
+    span (y, min (x0, x1), max (x0, x1), color);
+}
+
+// even-odd fill of a polygon given in pixels
+void raster_gc::fill_polygon (const std::vector<Magick::Coordinate> &points, unsigned color) {
+  if (points.size () < 3)
+    return;
+  double top = 1e30, bottom = -1e30;
+  for (unsigned i = 0; i < points.size (); ++ i) {
+    top = min (top, points[i].y ());
+    bottom = max (bottom, points[i].y ());
+  }
+
+  std::vector<double> xs;
+  int a = edge (top), b = edge (bottom);
+  if (!recording) {
+    a = max (0, a);
+    b = min (height, b);
+  }
+  for (int y = a; y < b; ++ y) {
+    xs.clear ();
+    for (unsigned i = 0; i < points.size (); ++ i) {
+      const Magick::Coordinate &p = points[i];
+      const Magick::Coordinate &q = points[(i + 1) % points.size ()];
+      if ((p.y () <= y && q.y () > y) || (q.y () <= y && p.y () > y))
+	xs.push_back (p.x () + (y - p.y ()) * (q.x () - p.x ()) / (q.y () - p.y ()));
+    }
+    sort (xs.begin (), xs.end ());
+    for (unsigned i = 0; i + 1 < xs.size (); i += 2)
+      span (y, xs[i], xs[i + 1], color);
+  }
+}
+
+// a line from pixel (x1, y1) to (x2, y2) with butt ends, as
+// ImageMagick draws it
+void raster_gc::stroke_line (double x1, double y1, double x2, double y2) {
+  const state &s = states.back ();
+  double w = max (1.0, s.stroke_width * sqrt (fabs (s.sx * s.sy))) / 2;
+
+  if (y1 == y2)
+    fill_rect (x1, y1 - w, x2, y2 + w, s.stroke);
+  else if (x1 == x2)
+    fill_rect (x1 - w, y1, x2 + w, y2, s.stroke);
+  else {
+    double dx = x2 - x1, dy = y2 - y1, len = sqrt (dx * dx + dy * dy);
+    double nx = -dy / len * w, ny = dx / len * w;
+    std::vector<Magick::Coordinate> quad;
+    quad.push_back (Magick::Coordinate (x1 + nx, y1 + ny));
+    quad.push_back (Magick::Coordinate (x2 + nx, y2 + ny));
+    quad.push_back (Magick::Coordinate (x2 - nx, y2 - ny));
+    quad.push_back (Magick::Coordinate (x1 - nx, y1 - ny));
+    fill_polygon (quad, s.stroke);
+  }
+}
+
+// ------------------------------------------------------------
+// cubic segments, flattened into lines a few pixels long
+
+void raster_gc::bezier (const Magick::CoordinateList &points) {
+  if (points.empty ())
+    return;
+  std::vector<Magick::Coordinate> p;
+  for (unsigned i = 0; i < points.size (); ++ i)
+    p.push_back (map (points[i].x (), points[i].y ()));
+
+  for (unsigned i = 0; i + 3 < p.size (); i += 3) {
+    double len = 0;
+    for (unsigned k = i; k < i + 3; ++ k)
+      len += hypot (p[k + 1].x () - p[k].x (), p[k + 1].y () - p[k].y ());
+    int steps = max (1, min (256, (int) (len / 4)));
+
+    double x0 = p[i].x (), y0 = p[i].y ();
+    for (int k = 1; k <= steps; ++ k) {
+      double t = (double) k / steps, u = 1 - t;
+      double a = u * u * u, b = 3 * u * u * t, c = 3 * u * t * t, d = t * t * t;
+      double x = a * p[i].x () + b * p[i + 1].x () + c * p[i + 2].x () + d * p[i + 3].x ();
+      double y = a * p[i].y () + b * p[i + 1].y () + c * p[i + 2].y () + d * p[i + 3].y ();
+      stroke_line (x0, y0, x, y);
+      x0 = x;
+      y0 = y;
+    }
+  }
+}
+
+// ------------------------------------------------------------
+
+void raster_gc::fill_color (const std::string &name) {
+  states.back ().filled = strcasecmp (name.c_str (), "none") != 0;
+  states.back ().fill = parse_color (name);
+}
+
+// ------------------------------------------------------------
+
+void raster_gc::fill_opacity (int op) {
+  if (op == 0)
+    states.back ().filled = false;
+}
+
+// ------------------------------------------------------------
+// there is only the one built-in font
+
+void raster_gc::font (const std::string &) {
+}
+
+// ------------------------------------------------------------
+
+void raster_gc::line (int x1, int y1, int x2, int y2) {
+  Magick::Coordinate a = map (x1, y1), b = map (x2, y2);
+  stroke_line (a.x (), a.y (), b.x (), b.y ());
+}
+
+void raster_gc::drawrect (int x1, int y1, int x2, int y2) {
+  Magick::Coordinate a = map (x1, y1), b = map (x2, y2);
+  if (states.back ().filled)
+    fill_rect (a.x (), a.y (), b.x (), b.y (), states.back ().fill);
+  stroke_line (a.x (), a.y (), b.x (), a.y ());
+  stroke_line (b.x (), a.y (), b.x (), b.y ());
+  stroke_line (b.x (), b.y (), a.x (), b.y ());
+  stroke_line (a.x (), b.y (), a.x (), a.y ());
+}
+
+// ------------------------------------------------------------
+
+void raster_gc::point_size (int size) {
+  states.back ().point_size = size;
+}
+
+// ------------------------------------------------------------
+
+void raster_gc::polygon (const Magick::CoordinateList &points) {
+  std::vector<Magick::Coordinate> p;
+  for (unsigned i = 0; i < points.size (); ++ i)
+    p.push_back (map (points[i].x (), points[i].y ()));
+  if (states.back ().filled)
+    fill_polygon (p, states.back ().fill);
+  for (unsigned i = 0; i < p.size (); ++ i) {
+    const Magick::Coordinate &q = p[(i + 1) % p.size ()];
+    stroke_line (p[i].x (), p[i].y (), q.x (), q.y ());
+  }
+}
+
+// ------------------------------------------------------------
+
+void raster_gc::pop (void) {
+  if (states.size () > 1)
+    states.pop_back ();
+}
+
+// ------------------------------------------------------------
+
+void raster_gc::push (void) {
+  states.push_back (states.back ());
+}
+
+// ------------------------------------------------------------
+
+void raster_gc::scaling (double hscale, double vscale) {
+  states.back ().sx *= hscale;
+  states.back ().sy *= vscale;
+}
+
+// ------------------------------------------------------------
+
+void raster_gc::translate (double dx, double dy) {
+  state &s = states.back ();
+  s.tx += s.sx * dx;
+  s.ty += s.sy * dy;
+}
+
+// ------------------------------------------------------------
+
+void raster_gc::stroke_color (const std::string &name) {
+  states.back ().stroke = parse_color (name);
+}
+
+// ------------------------------------------------------------
+
+void raster_gc::stroke_width (int w) {
+  states.back ().stroke_width = w;
+}
+
+// ------------------------------------------------------------
+// the text sits on its baseline at y, in the fill colour like
+// ImageMagick draws it
+
+void raster_gc::text (int x, int y, const std::string &text) {
+  const state &s = states.back ();
+  unsigned color = s.filled ? s.fill : s.stroke;
+  double dw = glyph_advance * s.point_size * fabs (s.sx) / 6;
+  double dh = s.point_size * fabs (s.sy) / 8;
+  Magick::Coordinate origin = map (x, y);
+  double left = origin.x (), top = origin.y () - 7 * dh;
+
+  if (top > height || top + 8 * dh < 0)
+    return;
+  for (std::string::size_type i = 0; i < text.size (); ++ i, left += 6 * dw) {
+    unsigned char c = text[i];
+    if (c < ' ' || c > '~' || left > width)
+      continue;
+    for (int col = 0; col < 5; ++ col) {
+      unsigned bits = glyphs[c - ' '][col];
+      for (int row = 0; bits; ++ row, bits >>= 1) {
+	if (!(bits & 1))
+	  continue;
+	// runs of dots down a column are filled at once
+	int end = row;
+	while (bits & 2) {
+	  bits >>= 1;
+	  ++ end;
+	}
+	fill_rect (left + col * dw, top + row * dh,
+		   left + (col + 1) * dw, top + (end + 1) * dh, color);
+	row = end;
+      }
+    }
+  }
+}
+
+// ------------------------------------------------------------
+// cells of the same shape look the same wherever they are, as long as
+// they lie at the same offset within their pixels
+
+bool raster_gc::stamp_key::operator< (const stamp_key &k) const {
+  if (shape != k.shape)
+    return shape < k.shape;
+  if (stroke != k.stroke)
+    return stroke < k.stroke;
+  if (stroke_width != k.stroke_width)
+    return stroke_width < k.stroke_width;
+  if (fx != k.fx)
+    return fx < k.fx;
+  if (fy != k.fy)
+    return fy < k.fy;
+  if (sx != k.sx)
+    return sx < k.sx;
+  return sy < k.sy;
+}
+
+bool raster_gc::cell (unsigned shape, int x, int y) {
+  const state &s = states.back ();
+  Magick::Coordinate origin = map (x, y);
+  stamp_key key;
+  key.shape = shape;
+  key.stroke = s.stroke;
+  key.stroke_width = s.stroke_width;
+  key.sx = s.sx;
+  key.sy = s.sy;
+  stamp_x = (int) floor (origin.x ());
+  stamp_y = (int) floor (origin.y ());
+  key.fx = (int) floor ((origin.x () - stamp_x) * 64 + 0.5);
+  key.fy = (int) floor ((origin.y () - stamp_y) * 64 + 0.5);
+
+  std::map<stamp_key, std::vector<stamp_run> >::iterator i = stamps.find (key);
+  if (i == stamps.end ()) {
+    recording = &stamps[key];
+    return false;
+  }
+
+  unsigned *p = canvas ();
+  if (p == NULL)
+    return true;
+  const std::vector<stamp_run> &runs = i->second;
+  for (unsigned k = 0; k < runs.size (); ++ k) {
+    int y = stamp_y + runs[k].dy;
+    int a = max (0, stamp_x + runs[k].x0), b = min (width, stamp_x + runs[k].x1);
+    if (y >= 0 && y < height && a < b)
+      fill_n (p + (size_t) y * width + a, b - a, runs[k].color);
+  }
+  return true;
+}
+
+void raster_gc::end_cell (void) {
+  recording = NULL;
+}
+
+// ------------------------------------------------------------
+// PNG files are written as 8 bit RGB, one deflate stream for the image
+
+// filled before main(), so that images can be written on several
+// threads at once
+
+static struct crc_table {
+  unsigned long v[256];
+  crc_table (void) {
+    for (unsigned i = 0; i < 256; ++ i) {
+      unsigned long c = i;
+      for (int k = 0; k < 8; ++ k)
+	c = c & 1 ? 0xedb88320UL ^ (c >> 1) : c >> 1;
+      v[i] = c;
+    }
+  }
+} crc_table;
+
+static unsigned long crc (unsigned long c, const unsigned char *p, size_t n) {
+  c ^= 0xffffffffUL;
+  while (n--)
+    c = crc_table.v[(c ^ *p++) & 0xff] ^ (c >> 8);
+  return c ^ 0xffffffffUL;
+}
+
+static void put_word (std::string &s, unsigned long v) {
+  s += (char) (v >> 24);
+  s += (char) (v >> 16);
+  s += (char) (v >> 8);
+  s += (char) v;
+}
+
+static void write_chunk (ostream &out, const char *type, const std::string &data) {
+  std::string chunk (type, 4);
+  chunk += data;
+  std::string head, tail;
+  put_word (head, data.size ());
+  put_word (tail, crc (0, (const unsigned char *) chunk.data (), chunk.size ()));
+  out << head << chunk << tail;
+}
+
+// without zlib the image goes into stored, uncompressed deflate blocks
+static std::string compress_image (const std::string &raw) {
+#ifdef USE_ZLIB
+  uLongf size = compressBound (raw.size ());
+  std::string packed (size, '\0');
+  if (compress2 ((Bytef *) &packed[0], &size, (const Bytef *) raw.data (), raw.size (),
+		 Z_DEFAULT_COMPRESSION) == Z_OK) {
+    packed.resize (size);
+    return packed;
+  }
+#endif /* USE_ZLIB */
+  std::string z ("\x78\x01", 2);
+  unsigned long a = 1, b = 0;
+  for (size_t i = 0; i < raw.size (); ++ i) {
+    a = (a + (unsigned char) raw[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  size_t pos = 0;
+  do {
+    size_t n = min ((size_t) 65535, raw.size () - pos);
+    z += (char) (pos + n == raw.size ());
+    z += (char) n;
+    z += (char) (n >> 8);
+    z += (char) ~n;
+    z += (char) (~n >> 8);
+    z.append (raw, pos, n);
+    pos += n;
+  } while (pos < raw.size ());
+  put_word (z, b << 16 | a);
+  return z;
+}
+
+// ------------------------------------------------------------
+
+void raster_gc::print (const std::string &filename) {
+  canvas ();
+
+  std::ofstream out;
+  out.exceptions (ofstream::failbit | ofstream::badbit);
+  out.open (filename.c_str (), ios::binary);
+
+  std::string::size_type dot = filename.rfind ('.');
+  bool png = dot != std::string::npos && !strcasecmp (filename.c_str () + dot + 1, "png");
+
+  // each row is preceded by its PNG filter type, none
+  std::string rgb;
+  rgb.reserve ((size_t) height * (width * 3 + 1));
+  for (int y = 0; y < height; ++ y) {
+    if (png)
+      rgb += '\0';
+    const unsigned *p = &pixels[(size_t) y * width];
+    for (int x = 0; x < width; ++ x) {
+      rgb += (char) (p[x] >> 16);
+      rgb += (char) (p[x] >> 8);
+      rgb += (char) p[x];
+    }
+  }
+
+  if (!png) {
+    out << "P6\n" << width << ' ' << height << "\n255\n" << rgb;
+    return;
+  }
+
+  std::string header;
+  put_word (header, width);
+  put_word (header, height);
+  header += "\x08\x02";		// 8 bit RGB
+  header.append (3, '\0');	// deflate, adaptive filters, no interlace
+  out << "\x89PNG\r\n\x1a\n";
+  write_chunk (out, "IHDR", header);
+  write_chunk (out, "IDAT", compress_image (rgb));
+  write_chunk (out, "IEND", std::string ());
+}
+
+// ------------------------------------------------------------
+
+bool raster_gc::has_raster_ext (const std::string &filename) {
+  std::string::size_type dot = filename.rfind ('.');
+  if (dot == std::string::npos)
+    return false;
+  const char *ext = filename.c_str () + dot + 1;
+  return !(strcasecmp (ext, "png") && strcasecmp (ext, "ppm"));
+}
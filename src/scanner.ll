@@ -20,13 +20,26 @@
 #ifdef HAVE_CONFIG_H
 #  include <config.h>
 #endif
-#include "globals.h"
+#include "parse.h"
 #include "parser.hh"
+#include <deque>
+
+// flex reuses its buffer for every token, so token texts are copied
+// here and kept until the timeslice they belong to is complete
+struct flex_text {
+  std::deque<std::string> tokens;
+  bool release;
+};
+
+static void save_text (YYSTYPE *lval, flex_text *t, const char *s, int len,
+		       bool unescape);
 %}
 
+%option reentrant bison-bridge
+%option extra-type="flex_text *"
 %option yylineno
 %option noyywrap
-%x COMMENT QUOTE DELAYTEXT
+%x COMMENT
 SYM [A-Za-z0-9_]+
 
 %%
@@ -34,20 +47,67 @@ SYM [A-Za-z0-9_]+
 <COMMENT>\n     BEGIN(INITIAL); 
 <COMMENT>.*     ;
 
-<QUOTE>\"       BEGIN(INITIAL); return STRING;
-<QUOTE>\\.      yylval += yytext[1];
-<QUOTE>\n       return -1;
-<QUOTE>.        yylval += yytext[0];
-
-<DELAYTEXT>>    BEGIN(INITIAL); return DELAY;
-<DELAYTEXT>\\.  yylval += yytext[1];
-<DELAYTEXT>\n   return -1;
-<DELAYTEXT>.    yylval += yytext[0];
-
-{SYM}(\.{SYM})* yylval = std::string (yytext, yyleng); return SYMBOL;
-\"              BEGIN(QUOTE); yylval.erase ();
+{SYM}(\.{SYM})* save_text (yylval, yyextra, yytext, yyleng, false); return SYMBOL;
+\"([^\"\\\n]|\\.)*\"  save_text (yylval, yyextra, yytext + 1, yyleng - 2, true); return STRING;
+\"([^\"\\\n]|\\.)*    return -1;
 =>              return CAUSE;
--               BEGIN(DELAYTEXT); yylval.erase ();
+-([^>\\\n]|\\.)*>     save_text (yylval, yyextra, yytext + 1, yyleng - 2, true); return DELAY;
+-([^>\\\n]|\\.)*      return -1;
 #               BEGIN(COMMENT);
 [\n\t ]+        ;
 .               return yytext[0];
+
+%%
+
+static void save_text (YYSTYPE *lval, flex_text *t, const char *s, int len,
+		       bool unescape) {
+  t->tokens.push_back (std::string ());
+  std::string &text = t->tokens.back ();
+  for (int i = 0; i < len; ++ i) {
+    if (unescape && s[i] == '\\')
+      ++ i;
+    text += s[i];
+  }
+  lval->text = text.data ();
+  lval->len = text.size ();
+}
+
+namespace {
+
+  class flex_lexer : public timing::lexer {
+    yyscan_t scanner;
+    flex_text text;
+
+  public:
+    flex_lexer (FILE *in) {
+      text.release = false;
+      yylex_init_extra (&text, &scanner);
+      yyset_in (in, scanner);
+    }
+
+    ~flex_lexer () {
+      yylex_destroy (scanner);
+    }
+
+    int lex (YYSTYPE *lval) {
+      // the tokens before the last '.' have all been reduced
+      if (text.release) {
+	text.tokens.clear ();
+	text.release = false;
+      }
+      int token = yylex (lval, scanner);
+      if (token == '.')
+	text.release = true;
+      return token;
+    }
+
+    int lineno (void) {
+      return yyget_lineno (scanner);
+    }
+  };
+};
+
+int timing::parse (FILE *in, parse_context &ctx) {
+  flex_lexer lex (in);
+  return yyparse (lex, ctx);
+}
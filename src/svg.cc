@@ -0,0 +1,260 @@
+// This file is part of drawtiming.
+//
+// Drawtiming is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Drawtiming is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with drawtiming; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// SVG output.  Nothing is kept but the graphics state: push, pop and
+// the other state changes only touch the stack of states, and each
+// element is written at once into a flat <g> whose attributes carry
+// the whole state.  A new group is begun whenever the state differs
+// from that of the open one.
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+#include "timing.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+using namespace timing;
+using namespace std;
+
+// ------------------------------------------------------------
+
+static std::string escape (const std::string &s) {
+  std::string e;
+  for (std::string::size_type i = 0; i < s.size (); ++ i)
+    switch (s[i]) {
+    case '&': e += "&amp;"; break;
+    case '<': e += "&lt;"; break;
+    case '>': e += "&gt;"; break;
+    case '"': e += "&quot;"; break;
+    default: e += s[i];
+    }
+  return e;
+}
+
+// ------------------------------------------------------------
+// a number in plain decimals, as the stream's default precision would
+// round large coordinates and write them in scientific notation
+
+static std::string num (double v) {
+  char buf[64];
+  if (v == floor (v) && fabs (v) < 1e15)
+    sprintf (buf, "%.0f", v);
+  else {
+    sprintf (buf, "%.4f", v);
+    size_t n = strlen (buf);
+    while (buf[n - 1] == '0')
+      buf[-- n] = 0;
+    if (buf[n - 1] == '.')
+      buf[-- n] = 0;
+  }
+  return buf;
+}
+
+// ------------------------------------------------------------
+
+bool svg_gc::state::operator== (const state &s) const {
+  return sx == s.sx && sy == s.sy && tx == s.tx && ty == s.ty
+    && stroke == s.stroke && fill == s.fill && font == s.font
+    && fill_opacity == s.fill_opacity && stroke_width == s.stroke_width
+    && point_size == s.point_size;
+}
+
+// ------------------------------------------------------------
+// ImageMagick's defaults, which render() relies on for the fill
+
+svg_gc::svg_gc (std::ostream &o) : out (o), begun (false), grouped (false) {
+  state s;
+  s.sx = s.sy = 1;
+  s.tx = s.ty = 0;
+  s.stroke = "none";
+  s.fill = "black";
+  s.font = "Helvetica";
+  s.fill_opacity = 1;
+  s.stroke_width = 1;
+  s.point_size = 12;
+  states.push_back (s);
+}
+
+svg_gc::~svg_gc (void) {
+}
+
+// ------------------------------------------------------------
+// where the next element goes, once the document and a group with
+// the current state have been begun
+
+std::ostream &svg_gc::element (void) {
+  if (!begun) {
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	<< "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << width
+	<< "\" height=\"" << height << "\" viewBox=\"0 0 " << width << ' ' << height
+	<< "\">\n<rect width=\"100%\" height=\"100%\" fill=\""
+	<< escape (vColor_Bg) << "\"/>\n";
+    begun = true;
+  }
+
+  const state &s = states.back ();
+  if (!grouped || !(s == written)) {
+    if (grouped)
+      out << "</g>\n";
+    out << "<g transform=\"matrix(" << num (s.sx) << " 0 0 " << num (s.sy) << ' '
+	<< num (s.tx) << ' ' << num (s.ty) << ")\" stroke=\"" << escape (s.stroke)
+	<< "\" stroke-width=\"" << s.stroke_width << "\" fill=\"" << escape (s.fill)
+	<< "\" font-family=\"" << escape (s.font) << "\" font-size=\"" << s.point_size
+	<< '"';
+    if (s.fill_opacity == 0)
+      out << " fill-opacity=\"0\"";
+    out << ">\n";
+    written = s;
+    grouped = true;
+  }
+  return out;
+}
+
+// ------------------------------------------------------------
+
+void svg_gc::bezier (const Magick::CoordinateList &points) {
+  if (points.empty ())
+    return;
+  std::ostream &o = element ();
+  o << "<path fill=\"none\" d=\"M" << num (points[0].x ()) << ' ' << num (points[0].y ()) << 'C';
+  for (unsigned i = 1; i < points.size (); ++ i)
+    o << (i > 1 ? " " : "") << num (points[i].x ()) << ' ' << num (points[i].y ());
+  o << "\"/>\n";
+}
+
+// ------------------------------------------------------------
+
+void svg_gc::fill_color (const std::string &name) {
+  states.back ().fill = name;
+}
+
+// ------------------------------------------------------------
+
+void svg_gc::fill_opacity (int op) {
+  states.back ().fill_opacity = op;
+}
+
+// ------------------------------------------------------------
+
+void svg_gc::font (const std::string &name) {
+  states.back ().font = name;
+}
+
+// ------------------------------------------------------------
+
+void svg_gc::line (int x1, int y1, int x2, int y2) {
+  element () << "<line x1=\"" << x1 << "\" y1=\"" << y1
+	     << "\" x2=\"" << x2 << "\" y2=\"" << y2 << "\"/>\n";
+}
+
+void svg_gc::drawrect (int x1, int y1, int x2, int y2) {
+  element () << "<rect x=\"" << min (x1, x2) << "\" y=\"" << min (y1, y2)
+	     << "\" width=\"" << abs (x2 - x1) << "\" height=\"" << abs (y2 - y1)
+	     << "\"/>\n";
+}
+
+void svg_gc::polyline (const Magick::CoordinateList &points) {
+  std::ostream &o = element ();
+  o << "<polyline fill=\"none\" points=\"";
+  for (unsigned i = 0; i < points.size (); ++ i)
+    o << (i > 0 ? " " : "") << num (points[i].x ()) << ',' << num (points[i].y ());
+  o << "\"/>\n";
+}
+
+// ------------------------------------------------------------
+
+void svg_gc::point_size (int size) {
+  states.back ().point_size = size;
+}
+
+// ------------------------------------------------------------
+
+void svg_gc::polygon (const Magick::CoordinateList &points) {
+  std::ostream &o = element ();
+  o << "<polygon points=\"";
+  for (unsigned i = 0; i < points.size (); ++ i)
+    o << (i > 0 ? " " : "") << num (points[i].x ()) << ',' << num (points[i].y ());
+  o << "\"/>\n";
+}
+
+// ------------------------------------------------------------
+
+void svg_gc::pop (void) {
+  if (states.size () > 1)
+    states.pop_back ();
+}
+
+// ------------------------------------------------------------
+
+void svg_gc::push (void) {
+  states.push_back (states.back ());
+}
+
+// ------------------------------------------------------------
+
+void svg_gc::scaling (double hscale, double vscale) {
+  states.back ().sx *= hscale;
+  states.back ().sy *= vscale;
+}
+
+// ------------------------------------------------------------
+
+void svg_gc::translate (double dx, double dy) {
+  state &s = states.back ();
+  s.tx += s.sx * dx;
+  s.ty += s.sy * dy;
+}
+
+// ------------------------------------------------------------
+
+void svg_gc::stroke_color (const std::string &name) {
+  states.back ().stroke = name;
+}
+
+// ------------------------------------------------------------
+
+void svg_gc::stroke_width (int w) {
+  states.back ().stroke_width = w;
+}
+
+// ------------------------------------------------------------
+// the outline ImageMagick draws around text only blurs it here
+
+void svg_gc::text (int x, int y, const std::string &text) {
+  element () << "<text x=\"" << x << "\" y=\"" << y << "\" stroke=\"none\">"
+	     << escape (text) << "</text>\n";
+}
+
+// ------------------------------------------------------------
+
+void svg_gc::finish (void) {
+  if (!begun)
+    element ();
+  if (grouped)
+    out << "</g>\n";
+  out << "</svg>\n";
+  grouped = false;
+}
+
+// ------------------------------------------------------------
+
+bool svg_gc::has_svg_ext (const std::string &filename) {
+  std::string::size_type dot = filename.rfind ('.');
+  return dot != std::string::npos && !strcasecmp (filename.c_str () + dot + 1, "svg");
+}
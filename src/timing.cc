@@ -23,7 +23,13 @@
 #include "timing.h"
 #include <map>
 #include <fstream>
+#include <algorithm>
+#include <stdio.h>
 #include <string.h>
+#include <math.h>
+#ifdef HAVE_PTHREAD_H
+#  include <pthread.h>
+#endif
 
 using namespace timing;
 using namespace Magick;
@@ -41,6 +47,8 @@ std::string timing::vFont = "Helvetica";
 std::string timing::vColor_Bg = "white";
 std::string timing::vColor_Fg = "black";
 std::string timing::vColor_Dep = "blue";
+bool timing::vFitText = false;
+font_metrics timing::vMetrics;
 
 static int vCellHsep, vCellH, vCellHtxt, vCellHdel, vCellHtdel, vCellWtsep,
             vCellWrm;
@@ -62,41 +70,54 @@ const char *not_found::what (void) const throw () {
 
 // ------------------------------------------------------------
 
-sigvalue::sigvalue (void) {
-  type = UNDEF;
+bad_color::bad_color (const std::string &name) throw () {
+  text = "unknown color \"";
+  text += name;
+  text += "\"";
 }
 
-sigvalue::sigvalue (const sigvalue &t) {
-  *this = t;
+bad_color::~bad_color () throw () {
+}
+
+const char *bad_color::what (void) const throw () {
+  return text.c_str ();
+}
+
+// ------------------------------------------------------------
+
+bad_file::bad_file (const std::string &filename, const char *msg) throw () {
+  text = filename;
+  text += ": ";
+  text += msg;
+}
+
+bad_file::~bad_file () throw () {
+}
+
+const char *bad_file::what (void) const throw () {
+  return text.c_str ();
+}
+
+// ------------------------------------------------------------
+
+sigvalue::sigvalue (void) {
+  type = UNDEF;
+  text = TEXT_NONE;
 }
 
-sigvalue::sigvalue (const std::string &s, valuetype n) {
-  text = s;
+sigvalue::sigvalue (valuetype n, unsigned t) {
   type = n;
-  if (type == UNDEF) {
-    if (text == "0" || text == "false")
-      type = ZERO;
-    else if (text == "1" || text == "true")
-      type = ONE;
-    else if (text == "pulse")
-      type = PULSE;
-    else if (text == "tick")
-      type = TICK;
-    else if (text == "X")
-      type = X;
-    else if (text == "Z")
-      type = Z;
-    else
-      type = STATE;
-  }
+  text = t;
 }
 
 // ------------------------------------------------------------
 
-sigvalue &sigvalue::operator= (const sigvalue &t) {
-  type = t.type;
-  text = t.text;
-  return *this;
+bool sigvalue::operator== (const sigvalue &t) const {
+  return type == t.type && text == t.text;
+}
+
+bool sigvalue::operator!= (const sigvalue &t) const {
+  return !(*this == t);
 }
 
 // ------------------------------------------------------------
@@ -106,100 +127,327 @@ sigdata::sigdata (void) {
   maxdelays = 0;
 }
 
-sigdata::sigdata (const sigdata &d) {
-  *this = d;
+// ------------------------------------------------------------
+
+unsigned sigdata::length (void) const {
+  return runs.empty () ? 0 : runs.back ().start + runs.back ().length;
 }
 
 // ------------------------------------------------------------
 
-sigdata &sigdata::operator= (const sigdata &d) {
-  numdelays = d.numdelays;
-  maxdelays = d.maxdelays;
-  data = d.data;
-  return *this;
+static bool run_before (unsigned n, const sigrun &r) {
+  return n < r.start;
+}
+
+run_sequence::const_iterator sigdata::find (unsigned n) const {
+  // find the last run starting at or before n, which either contains
+  // n or is held through it
+  run_sequence::const_iterator i =
+    upper_bound (runs.begin (), runs.end (), n, run_before);
+  if (i == runs.begin ())
+    return runs.end ();
+  return -- i;
 }
 
 // ------------------------------------------------------------
 
-data::data (void) : maxlen (0) {
+sigvalue sigdata::held (const sigvalue &last) {
+  if (last.type == PULSE)
+    return sigvalue (ZERO, TEXT_ZERO);
+  return last;
+}
+
+// ------------------------------------------------------------
+
+sigvalue sigdata::at (unsigned n) const {
+  run_sequence::const_iterator i = find (n);
+  if (i == runs.end ())
+    return sigvalue (X, TEXT_X);
+  if (n < i->start + i->length)
+    return i->value;
+  return held (i->value);
 }
 
-data::data (const data &d) {
-  *this = d;
+// ------------------------------------------------------------
+
+void sigdata::set (unsigned n, const sigvalue &value) {
+  // a second value in the same cycle goes into the next one
+  if (n < length ())
+    n = length ();
+
+  // the last run absorbs the gap when it is held with the same value
+  if (!runs.empty ()) {
+    sigrun &r = runs.back ();
+    if (r.value == value && (r.start + r.length == n || held (r.value) == value)) {
+      r.length = n + 1 - r.start;
+      return;
+    }
+  }
+  sigrun r;
+  r.value = value;
+  r.start = n;
+  r.length = 1;
+  runs.push_back (r);
 }
 
 // ------------------------------------------------------------
 
-timing::data &data::operator= (const data &d) {
-  maxlen = d.maxlen;
-  signals = d.signals;
-  sequence = d.sequence;
-  dependencies = d.dependencies;
+run_cursor::run_cursor (const sigdata &s, unsigned from, unsigned t)
+  : sig (s), i (s.find (from)), n (from), to (t) {
+}
+
+bool run_cursor::next (sigvalue &value, unsigned &start, unsigned &length) {
+  if (n >= to)
+    return false;
+
+  // runs.end () stands for the cycles before the first run
+  unsigned end;
+  if (i == sig.runs.end ()) {
+    value = sigvalue (X, TEXT_X);
+    end = sig.runs.empty () ? to : sig.runs.front ().start;
+  }
+  else if (n < i->start + i->length) {
+    value = i->value;
+    end = i->start + i->length;
+  }
+  else {
+    value = sigdata::held (i->value);
+    end = i + 1 == sig.runs.end () ? to : (i + 1)->start;
+  }
+  start = n;
+  n = min (end, to);
+  length = n - start;
+
+  run_sequence::const_iterator j = (i == sig.runs.end () ? sig.runs.begin () : i + 1);
+  if (j != sig.runs.end () && j->start == n)
+    i = j;
+  return true;
+}
+
+// ------------------------------------------------------------
+
+data::data (void) : maxlen (0) {
+  texts.intern ("X");
+  texts.intern ("0");
+}
+
+// ------------------------------------------------------------
+
+bool string_table::span::operator< (const span &s) const {
+  int c = memcmp (p, s.p, min (n, s.n));
+  return c < 0 || (c == 0 && n < s.n);
+}
+
+// the spans of a copy must point into its own strings
+
+string_table::string_table (const string_table &t) {
+  *this = t;
+}
+
+string_table &string_table::operator= (const string_table &t) {
+  strings = t.strings;
+  unused = t.unused;
+  index.clear ();
+  for (map<span, unsigned>::const_iterator i = t.index.begin (); i != t.index.end (); ++ i)
+    index.insert (make_pair (span (strings[i->second].data (), i->first.n), i->second));
   return *this;
 }
 
 // ------------------------------------------------------------
 
-sigdata &data::find_signal (const signame &name) {
-  signal_database::iterator i = signals.find (name);
-  if (i == signals.end ()) {
-    i = signals.insert (signal_database::value_type (name, sigdata ())).first;
-    sequence.push_back (name);
+unsigned string_table::intern (const char *s, size_t n) {
+  map<span, unsigned>::iterator i = index.find (span (s, n));
+  if (i != index.end ())
+    return i->second;
+
+  unsigned id;
+  if (unused.empty ()) {
+    id = strings.size ();
+    strings.push_back (std::string (s, n));
+  }
+  else {
+    id = unused.back ();
+    unused.pop_back ();
+    strings[id].assign (s, n);
+  }
+  index.insert (make_pair (span (strings[id].data (), n), id));
+  return id;
+}
+
+// ------------------------------------------------------------
+
+void string_table::release (unsigned id) {
+  // a released slot may hold a copy of a live string, see intern
+  map<span, unsigned>::iterator i = index.find (span (strings[id].data (), strings[id].size ()));
+  if (i == index.end () || i->second != id)
+    return;
+  index.erase (i);
+  std::string ().swap (strings[id]);
+  unused.push_back (id);
+}
+
+// ------------------------------------------------------------
+
+bool string_table::find (const char *s, size_t n, unsigned &id) const {
+  map<span, unsigned>::const_iterator i = index.find (span (s, n));
+  if (i == index.end ())
+    return false;
+  id = i->second;
+  return true;
+}
+
+// ------------------------------------------------------------
+
+static bool glob_match (const char *p, const char *s) {
+  for (; *p; ++ p, ++ s) {
+    if (*p == '*') {
+      while (p[1] == '*')
+	++ p;
+      if (!p[1])
+	return true;
+      for (; *s; ++ s)
+	if (glob_match (p + 1, s))
+	  return true;
+      return false;
+    }
+    if (!*s || (*p != '?' && *p != *s))
+      return false;
   }
-  return i->second;
+  return !*s;
+}
+
+static bool glob_match (const vector<std::string> &patterns, const signame &name) {
+  for (vector<std::string>::const_iterator i = patterns.begin ();
+       i != patterns.end (); ++ i)
+    if (glob_match (i->c_str (), name.c_str ()))
+      return true;
+  return false;
+}
+
+bool signal_filter::selected (const signame &name) const {
+  return (include.empty () || glob_match (include, name))
+    && !glob_match (exclude, name);
+}
+
+// ------------------------------------------------------------
+
+sigid data::signal_id (const signame &name) {
+  return signal_id (name.data (), name.size ());
+}
+
+sigid data::signal_id (const char *name, size_t len) {
+  // the filter is only consulted for names which have not been seen
+  sigid id;
+  if (names.find (name, len, id))
+    return id;
+  if (dropped.find (name, len, id))
+    return no_signal;
+  if (!filter.selected (std::string (name, len))) {
+    dropped.intern (name, len);
+    return no_signal;
+  }
+  id = names.intern (name, len);
+  signals.push_back (sigdata ());
+  return id;
+}
+
+// ------------------------------------------------------------
+
+sigvalue data::value (const std::string &s, valuetype n) {
+  return value (s.data (), s.size (), n);
+}
+
+static bool is (const char *s, size_t len, const char *word) {
+  return len == strlen (word) && !memcmp (s, word, len);
+}
+
+sigvalue data::value (const char *s, size_t len, valuetype n) {
+  if (n == UNDEF) {
+    if (is (s, len, "0") || is (s, len, "false"))
+      n = ZERO;
+    else if (is (s, len, "1") || is (s, len, "true"))
+      n = ONE;
+    else if (is (s, len, "pulse"))
+      n = PULSE;
+    else if (is (s, len, "tick"))
+      n = TICK;
+    else if (is (s, len, "X"))
+      n = X;
+    else if (is (s, len, "Z"))
+      n = Z;
+    else
+      n = STATE;
+  }
+  return sigvalue (n, texts.intern (s, len));
+}
+
+// ------------------------------------------------------------
+
+sigdata &data::find_signal (const signame &name) {
+  sigid id = signal_id (name);
+  if (id == no_signal)
+    throw not_found (name);
+  return signals[id];
 }
 
 // ------------------------------------------------------------
 
 const sigdata &data::find_signal (const signame &name) const {
-  signal_database::const_iterator i = signals.find (name);
-  if (i == signals.end ()) 
+  sigid id;
+  if (!names.find (name, id))
     throw not_found (name);
-  return i->second;
+  return signals[id];
 }
 
 // ------------------------------------------------------------
 
-void data::add_dependency (const signame &name, const signame &dep) {
+void data::add_dependency (sigid name, sigid dep) {
+  if (name == no_signal || dep == no_signal)
+    return;
+
   // find the signal
-  sigdata &sig = find_signal (name);
-  sigdata &trigger = find_signal (dep);
+  sigdata &sig = signals[name];
+  sigdata &trigger = signals[dep];
   depdata d;
   d.trigger = dep;
   d.effect = name;
-  if ((d.n_trigger = trigger.data.size ()) > 0)
+  if ((d.n_trigger = trigger.length ()) > 0)
     -- d.n_trigger;
-  if ((d.n_effect = sig.data.size ()) > 0)
+  if ((d.n_effect = sig.length ()) > 0)
     -- d.n_effect;
   dependencies.push_back (d);
 }
 
 // ------------------------------------------------------------
 
-void data::add_dependencies (const signame &name, const signal_sequence &deps) {
+void data::add_dependencies (sigid name, const signal_sequence &deps) {
   for (signal_sequence::const_iterator j = deps.begin (); j != deps.end (); ++ j) 
     add_dependency (name, *j);
 }
 
 // ------------------------------------------------------------
 
-void data::add_delay (const signame &name, const signame &dep, const std::string &text) {
+void data::add_delay (sigid name, sigid dep, const std::string &text) {
   // a delay always indicates a dependency
   // (but would require a way to select which is rendered)
   // add_dependency (name, dep);
 
+  if (name == no_signal || dep == no_signal)
+    return;
+
   // find the signal
-  sigdata &sig = find_signal (name);
-  sigdata &trigger = find_signal (dep);
-  delaydata d;
+  sigdata &sig = signals[name];
+  sigdata &trigger = signals[dep];
+  delays.push_back (delaydata ());
+  delaydata &d = delays.back ();
   d.text = text;
   d.trigger = dep;
   d.effect = name;
   d.offset = trigger.numdelays;
 
-  if ((d.n_trigger = trigger.data.size ()) > 0)
+  if ((d.n_trigger = trigger.length ()) > 0)
     -- d.n_trigger;
-  if ((d.n_effect = sig.data.size ()) > 0)
+  if ((d.n_effect = sig.length ()) > 0)
     -- d.n_effect;
 
   // allow self-referential signals
@@ -209,25 +457,19 @@ void data::add_delay (const signame &name, const signame &dep, const std::string
   if (d.n_trigger != d.n_effect
       && ++ trigger.numdelays > trigger.maxdelays)
     trigger.maxdelays = trigger.numdelays;
-  delays.push_back (d);
 }
 
 // ------------------------------------------------------------
 
-void data::set_value (const signame &name, unsigned n, const sigvalue &value) {
-  // find the signal
-  sigdata &sig = find_signal (name);
+void data::set_value (sigid name, unsigned n, const sigvalue &value) {
+  if (name == no_signal)
+    return;
 
-  // pad the sequence so there are n data values
-  sigvalue lastval = (sig.data.size () == 0 ? sigvalue ("X", X) : sig.data.back ());
-  if (lastval.type == PULSE)
-    lastval = sigvalue ("0", ZERO);
-
-  while (sig.data.size () < n) 
-    sig.data.push_back (lastval);
+  // find the signal
+  sigdata &sig = signals[name];
 
-  // append the value to the sequence data
-  sig.data.push_back (value);
+  // the cycles it skipped are held implicitly
+  sig.set (n, value);
   sig.numdelays = 0;
 
   if (n + 1 > maxlen)
@@ -237,97 +479,211 @@ void data::set_value (const signame &name, unsigned n, const sigvalue &value) {
 // ------------------------------------------------------------
 
 void data::pad (unsigned n) {
-  // pad all sequences to length n
+  // all signals are held up to maxlen, so only that needs to grow
   if (n > maxlen)
     maxlen = n;
-  for (signal_database::iterator i = signals.begin (); i != signals.end (); ++ i) {
-    sigvalue lastval = (i->second.data.size () == 0 ? sigvalue ("X", X) : 
-			i->second.data.back ());
-    if (lastval.type == PULSE)
-      lastval = sigvalue ("0", ZERO);
-    while (i->second.data.size () < maxlen)
-      i->second.data.push_back (lastval);
+}
+
+// ------------------------------------------------------------
+
+template <class T>
+static void discard_arrows (vector<T> &arrows, unsigned n) {
+  typename vector<T>::iterator k = arrows.begin ();
+  for (typename vector<T>::iterator i = arrows.begin (); i != arrows.end (); ++ i)
+    if (i->n_trigger >= n || i->n_effect >= n)
+      *k++ = *i;
+  arrows.erase (k, arrows.end ());
+}
+
+void data::discard (unsigned n) {
+  // forget everything that ends before cycle n.  A run is held up to
+  // the next one, and the last run of each signal is always kept.
+  for (vector<sigdata>::iterator i = signals.begin (); i != signals.end (); ++ i) {
+    run_sequence::iterator j = i->runs.begin ();
+    while (j != i->runs.end () && j + 1 != i->runs.end ()
+	   && (j + 1)->start <= n)
+      ++ j;
+    i->runs.erase (i->runs.begin (), j);
   }
+  discard_arrows (dependencies, n);
+  discard_arrows (delays, n);
+
+  // release the texts no run holds any more, so a long stream of
+  // changing states needs no more than those of the kept cycles.
+  // The last value of each signal stays, and with it its text id.
+  vector<bool> used (texts.size ());
+  used[TEXT_X] = used[TEXT_ZERO] = true;
+  for (vector<sigdata>::const_iterator i = signals.begin (); i != signals.end (); ++ i)
+    for (run_sequence::const_iterator j = i->runs.begin (); j != i->runs.end (); ++ j)
+      if (j->value.text < used.size ())
+	used[j->value.text] = true;
+  for (unsigned k = 0; k < used.size (); ++ k)
+    if (!used[k])
+      texts.release (k);
 }
 
 // ------------------------------------------------------------
 
-ostream &operator<< (ostream &f, const sigvalue &data) {
-  return f << data.text;
+static void print_signal (ostream &f, const timing::data &data,
+			  const sigdata &sig) {
+  // one value per cycle, the implied ones included
+  run_cursor runs (sig, 0, max (data.maxlen, sig.length ()));
+  sigvalue value;
+  unsigned start, length;
+  bool first = true;
+  while (runs.next (value, start, length))
+    for (; length > 0; -- length, first = false)
+      f << (first ? "" : ", ") << data.texts[value.text];
 }
 
 // ------------------------------------------------------------
 
 ostream &operator<< (ostream &f, const timing::data &data) {
   f << "signals: " << endl;
-  for (signal_sequence::const_iterator i = data.sequence.begin ();
-       i != data.sequence.end (); ++ i) 
-    f << "  " << *i << ": " << data.find_signal (*i) << endl;
+  for (sigid i = 0; i < data.signals.size (); ++ i) {
+    f << "  " << data.names[i] << ": ";
+    print_signal (f, data, data.signals[i]);
+    f << endl;
+  }
 
   f << endl << "dependencies: " << endl;
-  for (list<depdata>::const_iterator i = data.dependencies.begin ();
+  for (vector<depdata>::const_iterator i = data.dependencies.begin ();
        i != data.dependencies.end (); ++ i) 
-    f << "  " << *i << endl;
+    f << "  " << data.names[i->trigger] << "(" << i->n_trigger << ") => "
+      << data.names[i->effect] << "(" << i->n_effect << ")" << endl;
 
   return f;
 }
 
 // ------------------------------------------------------------
+// vMetrics is shared by every render, and renders may run on several
+// threads, so the table is only touched under a lock
 
-ostream &operator<< (ostream &f, const sigdata &sig) {
-  int n = 0;
-  for (value_sequence::const_iterator i = sig.data.begin ();
-       i != sig.data.end (); ++ i, ++ n) {
-    if (n)
-      f << ", ";
-    f << *i;
-  }
-  return f;
-}
+namespace {
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_t metrics_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+  struct metrics_lock {
+    metrics_lock (void) { pthread_mutex_lock (&metrics_mutex); }
+    ~metrics_lock () { pthread_mutex_unlock (&metrics_mutex); }
+  };
+#else
+  struct metrics_lock {
+    metrics_lock (void) { }
+  };
+#endif /* HAVE_PTHREAD_H */
+};
 
 // ------------------------------------------------------------
+// calculate the required label width
 
-ostream &operator<< (ostream &f, const depdata &dep) {
-  f << dep.trigger << "(" << dep.n_trigger << ") => "
-    << dep.effect << "(" << dep.n_effect << ")";
-  return f;
+font_metrics::font_metrics (void) : changed (false) {
+#ifndef LITE
+  img = NULL;
+#endif /* ! LITE */
+}
+
+font_metrics::~font_metrics () {
+#ifndef LITE
+  delete img;
+#endif /* ! LITE */
 }
 
 // ------------------------------------------------------------
-// calculate the required label width
 
-static int label_width (const timing::data &d) {
-  int labelWidth = 0;
+double font_metrics::width (const std::string &font, int size, const std::string &text) {
+  metrics_lock hold;
+  // "font<tab>size<tab>text", built in place so that a text measured
+  // before costs no allocation
+  char num[16];
+  sprintf (num, "\t%d\t", size);
+  key.assign (font);
+  key += num;
+  key += text;
+  map<std::string, double>::iterator i = widths.find (key);
+  if (i != widths.end ())
+    return i->second;
 
 #ifndef LITE
+  if (img == NULL)
+    img = new Image;
   TypeMetric m;
-  Image img;
+  img->font (font);
+  img->fontPointsize (size);
+  img->fontTypeMetrics (text, &m);
+  double w = m.textWidth ();
+#else
+  double w = 0.7 * text.size () * size;
+#endif /* LITE */
+
+  widths.insert (make_pair (key, w));
+  changed = true;
+  return w;
+}
 
-  img.font (vFont);
-  img.fontPointsize(vFontPointsize);
-  for (signal_sequence::const_iterator i = d.sequence.begin ();
-       i != d.sequence.end (); ++ i) {
-    img.fontTypeMetrics (*i, &m);
-    if (m.textWidth () > labelWidth)
-      labelWidth = (int) m.textWidth ();
+// ------------------------------------------------------------
+// one "font<tab>size<tab>width<tab>text" line per text
+
+void font_metrics::load (const std::string &filename) {
+  metrics_lock hold;
+  ifstream in (filename.c_str ());
+  std::string line;
+  while (getline (in, line)) {
+    std::string::size_type a = line.find ('\t');
+    std::string::size_type b = a == std::string::npos ? a : line.find ('\t', a + 1);
+    std::string::size_type c = b == std::string::npos ? b : line.find ('\t', b + 1);
+    if (c == std::string::npos)
+      continue;
+    double w = atof (line.substr (b + 1, c - b - 1).c_str ());
+    widths[line.substr (0, b) + line.substr (c)] = w;
   }
-#else
-  int m = 0;
-  for (signal_sequence::const_iterator i = d.sequence.begin ();
-       i != d.sequence.end (); ++ i) {
-    if ((*i).size() > m)
-      m = (*i).size();
+}
+
+void font_metrics::save (const std::string &filename) {
+  metrics_lock hold;
+  if (!changed)
+    return;
+  ofstream out (filename.c_str ());
+  out.precision (17);
+  for (map<std::string, double>::const_iterator i = widths.begin ();
+       i != widths.end (); ++ i) {
+    std::string::size_type b = i->first.find ('\t', i->first.find ('\t') + 1);
+    out << i->first.substr (0, b) << '\t' << i->second << i->first.substr (b) << '\n';
   }
-  labelWidth = (int)(0.7 * m * vFontPointsize);
-#endif /* LITE */
+  changed = false;
+}
 
-  return labelWidth;
+// ------------------------------------------------------------
+
+static int label_width (const timing::data &d) {
+  double labelWidth = 0;
+  for (sigid i = 0; i < d.names.size (); ++ i)
+    labelWidth = max (labelWidth, vMetrics.width (vFont, vFontPointsize, d.names[i]));
+  return (int) labelWidth;
+}
+
+// ------------------------------------------------------------
+// shortens text with ".." until it is at most width wide
+
+static std::string fit_text (const std::string &text, double width) {
+  if (vMetrics.width (vFont, vFontPointsize, text) <= width)
+    return text;
+  std::string::size_type lo = 0, hi = text.size ();
+  while (lo < hi) {
+    std::string::size_type mid = (lo + hi + 1) / 2;
+    if (vMetrics.width (vFont, vFontPointsize, text.substr (0, mid) + "..") <= width)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo > 0 ? text.substr (0, lo) + ".." : std::string ();
 }
 
 // ------------------------------------------------------------
 // calculate the basic height and width required before scaling
 
-static void base_size (const timing::data &d, int &w, int &h) {
+static void base_size (const timing::data &d, int labelWidth, unsigned from, unsigned to,
+		       int &w, int &h) {
 
   vCellHsep = vCellHt / 8;
   vCellH=vCellHt-vCellHsep;
@@ -337,14 +693,12 @@ static void base_size (const timing::data &d, int &w, int &h) {
   vCellWtsep=vCellW/4;
   vCellWrm=vCellW/8;
 
-  w = vCellWrm*2 + label_width (d) + vCellW * d.maxlen;
+  w = vCellWrm*2 + labelWidth + vCellW * (to - from);
 
   h = 0;
-  for (signal_sequence::const_iterator i = d.sequence.begin ();
-       i != d.sequence.end (); ++ i) {
-    const sigdata &sig = d.find_signal (*i);
-    h += vCellHt + vCellHdel * sig.maxdelays;
-  }
+  for (vector<sigdata>::const_iterator i = d.signals.begin ();
+       i != d.signals.end (); ++ i)
+    h += vCellHt + vCellHdel * i->maxdelays;
 }
 
 // ------------------------------------------------------------
@@ -487,7 +841,6 @@ static void draw_transition (gc &gc, int x, int y, const sigvalue &last,
 	gc.line (x, y + vCellH, x + vCellW/4, y + vCellHsep);
 	gc.line (x + vCellW/4, y + vCellHsep, x + vCellW, y + vCellHsep);
 	gc.line (x + vCellW/4, y + vCellH, x + vCellW, y + vCellH);
-	push_text (gc, x + vCellW/4, y + vCellHtxt, value.text);
       }
       else {
 	gc.line (x, y + vCellHsep, x + vCellW, y + vCellHsep);
@@ -501,14 +854,12 @@ static void draw_transition (gc &gc, int x, int y, const sigvalue &last,
       gc.line (x, y + vCellH, x + vCellW/4, y + vCellHsep);
       gc.line (x + vCellW/4, y + vCellHsep, x + vCellW, y + vCellHsep);
       gc.line (x, y + vCellH, x + vCellW, y + vCellH);
-      push_text (gc, x + vCellW/4, y + vCellHtxt, value.text);
       break;
     
     case ONE:
       gc.line (x, y + vCellHsep, x + vCellW/4, y + vCellH);
       gc.line (x + vCellW/4, y + vCellH, x + vCellW, y + vCellH);
       gc.line (x, y + vCellHsep, x + vCellW, y + vCellHsep);
-      push_text (gc, x + vCellW/4, y + vCellHtxt, value.text);
       break;
     
     case Z:
@@ -516,15 +867,50 @@ static void draw_transition (gc &gc, int x, int y, const sigvalue &last,
       gc.line (x, y + vCellW/4, x + vCellW/8, y + vCellHsep);
       gc.line (x + vCellW/8, y + vCellH, x + vCellW, y + vCellH);
       gc.line (x + vCellW/8, y + vCellHsep, x + vCellW, y + vCellHsep);
-      push_text (gc, x + vCellW/8, y + vCellHtxt, value.text);
       break;
     }
   }
 }
 
 // ------------------------------------------------------------
+// the shape of a cell, apart from its label, as it depends only on
+// the two values
+
+static unsigned cell_shape (const sigvalue &last, const sigvalue &value) {
+  return (last.type * 8 + value.type) * 2 + (value.text != last.text);
+}
+
+// ------------------------------------------------------------
+// the label of a state, at the start of a cell drawn by draw_transition
+
+static void draw_label (gc &gc, int x, int y, const sigvalue &last,
+			const sigvalue &value, const std::string &label) {
+  if (value.type != STATE)
+    return;
+
+  switch (last.type) {
+  default:
+    if (value.text != last.text)
+      push_text (gc, x + vCellW/4, y + vCellHtxt, label);
+    break;
 
-static void draw_dependency (gc &gc, int x0, int y0, int x1, int y1) {
+  case ZERO:
+  case TICK:
+  case PULSE:
+  case ONE:
+    push_text (gc, x + vCellW/4, y + vCellHtxt, label);
+    break;
+
+  case Z:
+    push_text (gc, x + vCellW/8, y + vCellHtxt, label);
+    break;
+  }
+}
+
+// ------------------------------------------------------------
+
+static void draw_dependency (gc &gc, int x0, int y0, int x1, int y1,
+			     bool head_shown = true) {
   CoordinateList shaft, head;
 
   gc.push ();
@@ -556,7 +942,8 @@ static void draw_dependency (gc &gc, int x0, int y0, int x1, int y1) {
   }
   else {
     int h = vCellHt/10, w1 = vCellW/12, w2 = vCellW/20;
-    x1 -= vCellW/16;
+    if (head_shown)
+      x1 -= vCellW/16;
     gc.fill_color ("none");
     gc.fill_opacity (0);
     shaft.push_back (Coordinate (x0, y0));
@@ -564,6 +951,10 @@ static void draw_dependency (gc &gc, int x0, int y0, int x1, int y1) {
     shaft.push_back (Coordinate ((x0 + x1) / 2, y1));
     shaft.push_back (Coordinate (x1, y1));
     gc.bezier (shaft);
+    if (!head_shown) {
+      gc.pop ();
+      return;
+    }
     gc.fill_color (timing::vColor_Dep);
     head.push_back (Coordinate (x1, y1));
     head.push_back (Coordinate (x1 - w1, y1 - h));
@@ -578,7 +969,8 @@ static void draw_dependency (gc &gc, int x0, int y0, int x1, int y1) {
 // ------------------------------------------------------------
 
 static void draw_delay (gc &gc, int x0, int y0, int x1, int y1, int y2,
-			const std::string &text) {
+			const std::string &text,
+			bool trigger_shown = true, bool effect_shown = true) {
   std::vector<Coordinate> head;
 
   gc.push ();
@@ -588,9 +980,15 @@ static void draw_delay (gc &gc, int x0, int y0, int x1, int y1, int y2,
     gc.line (x0, y0, x1, y1);
   else {
     gc.text (x0 + vCellWtsep, y2 - vCellHt/16, text);
-    gc.line (x0, y0, x0, y2 + vCellHt/8);
-    gc.line (x1, y1, x1, y2 - vCellHt/8);
+    if (trigger_shown)
+      gc.line (x0, y0, x0, y2 + vCellHt/8);
+    if (effect_shown)
+      gc.line (x1, y1, x1, y2 - vCellHt/8);
     gc.line (x0, y2, x1, y2);
+    if (!effect_shown) {
+      gc.pop ();
+      return;
+    }
     gc.fill_color (timing::vColor_Dep);
     head.push_back (Coordinate (x1, y2));
     head.push_back (Coordinate (x1 - vCellW/12, y2 - vCellHt/10));
@@ -604,92 +1002,368 @@ static void draw_delay (gc &gc, int x0, int y0, int x1, int y1, int y2,
 
 // ------------------------------------------------------------
 
-static void render_common (gc& gc, const timing::data &d,
-    			   double hscale, double vscale) {
+static bool in_range (unsigned n, unsigned from, unsigned to) {
+  return n >= from && n < to;
+}
 
+// ------------------------------------------------------------
+// the short bar which marks where an arrow leaves the rendered cycles
+
+static void draw_cut (gc &gc, int x, int y) {
   gc.push ();
+  gc.stroke_color (timing::vColor_Dep);
+  gc.line (x, y - vCellHt/8, x, y + vCellHt/8);
+  gc.pop ();
+}
+
+// ------------------------------------------------------------
+// where an arrow between two cycles lies within the rendered cycles.
+// Ends outside them are moved to the edge they lie beyond, and arrows
+// with both ends beyond the same edge are not visible at all.
+
+static int clip_cycle (unsigned n, unsigned from, unsigned to, int left, int right) {
+  if (n < from)
+    return left;
+  if (n >= to)
+    return right;
+  return left + vCellWrm + vCellW * (n - from);
+}
+
+struct arrow_span {
+  int x0, x1;
+  bool trigger_shown, effect_shown, visible;
+
+  arrow_span (unsigned n_trigger, unsigned n_effect, unsigned from, unsigned to,
+	      int left, int right)
+    : x0 (clip_cycle (n_trigger, from, to, left, right)),
+      x1 (clip_cycle (n_effect, from, to, left, right)),
+      trigger_shown (in_range (n_trigger, from, to)),
+      effect_shown (in_range (n_effect, from, to)) {
+    visible = from < to && (trigger_shown || effect_shown || x0 != x1);
+  }
+};
+
+// ------------------------------------------------------------
+
+// the label of a state value, which may take all the cycles it is held
+
+static std::string state_label (const timing::data &d, const sigvalue &value,
+				const run_cursor &rest, unsigned length) {
+  if (!vFitText)
+    return d.texts[value.text];
+  run_cursor ahead (rest);
+  unsigned held = length, s, l;
+  sigvalue v;
+  while (ahead.next (v, s, l) && v == value)
+    held += l;
+  return fit_text (d.texts[value.text], vCellW * held - vCellW/4);
+}
+
+// ------------------------------------------------------------
+// the part of the diagram inside the viewport, before scaling
+
+struct visible_area {
+  double x0, y0, x1, y1;
+
+  visible_area (const viewport &view, double hscale, double vscale) {
+    if (view.empty ()) {
+      x0 = y0 = -1e30;
+      x1 = y1 = 1e30;
+    }
+    else {
+      x0 = view.x / hscale;
+      y0 = view.y / vscale;
+      x1 = (view.x + view.w) / hscale;
+      y1 = (view.y + view.h) / vscale;
+    }
+  }
+
+  bool overlaps (double left, double top, double right, double bottom) const {
+    return left <= x1 && right >= x0 && top <= y1 && bottom >= y0;
+  }
+
+  // the cycles of [from, to) whose cells are at least partly visible
+  void cycles (int left, unsigned from, unsigned to,
+	       unsigned &vfrom, unsigned &vto) const {
+    double a = (x0 - left) / vCellW, b = (x1 - left) / vCellW;
+    vfrom = a <= 0 ? from : from + min ((double) (to - from), floor (a));
+    vto = b <= 0 ? from : from + min ((double) (to - from), ceil (b));
+  }
+};
+
+// ------------------------------------------------------------
+
+void gc::polyline (const Magick::CoordinateList &points) {
+  for (unsigned i = 1; i < points.size (); ++ i)
+    line ((int) points[i - 1].x (), (int) points[i - 1].y (),
+	  (int) points[i].x (), (int) points[i].y ());
+}
+
+// ------------------------------------------------------------
+// joins the lines render_common draws into polylines before passing
+// them on.  A line is added to whichever open polyline ends where it
+// begins, so the upper and lower edges of a state can grow side by
+// side; collinear segments are merged into one.  Lines of the same
+// stroke may be drawn in any order, so the open polylines are only
+// passed on before anything else is drawn or the stroke changes.
+
+namespace {
+
+  class polyline_gc : public gc {
+    timing::gc &target;
+    std::vector<CoordinateList> open;
+
+    // more than this and the oldest is passed on
+    enum { max_open = 8 };
+
+    void flush (void) {
+      for (unsigned i = 0; i < open.size (); ++ i)
+	if (open[i].size () == 2)
+	  target.line ((int) open[i][0].x (), (int) open[i][0].y (),
+		       (int) open[i][1].x (), (int) open[i][1].y ());
+	else
+	  target.polyline (open[i]);
+      open.clear ();
+    }
+
+    static bool extends (const CoordinateList &p, double x, double y) {
+      const Coordinate &a = p[p.size () - 2], &b = p.back ();
+      double dx0 = b.x () - a.x (), dy0 = b.y () - a.y ();
+      double dx1 = x - b.x (), dy1 = y - b.y ();
+      return dx0 * dy1 == dy0 * dx1 && dx0 * dx1 + dy0 * dy1 > 0;
+    }
+
+  public:
+    polyline_gc (timing::gc &t) : target (t) {
+      width = t.width;
+      height = t.height;
+      highlightRows = t.highlightRows;
+    }
+
+    ~polyline_gc () {
+      flush ();
+    }
+
+    void line (int x1, int y1, int x2, int y2) {
+      for (unsigned i = 0; i < open.size (); ++ i) {
+	CoordinateList &p = open[i];
+	if (p.back ().x () != x1 || p.back ().y () != y1)
+	  continue;
+	if (extends (p, x2, y2))
+	  p.back () = Coordinate (x2, y2);
+	else
+	  p.push_back (Coordinate (x2, y2));
+	return;
+      }
+      if (open.size () == max_open) {
+	const CoordinateList &p = open.front ();
+	if (p.size () == 2)
+	  target.line ((int) p[0].x (), (int) p[0].y (), (int) p[1].x (), (int) p[1].y ());
+	else
+	  target.polyline (p);
+	open.erase (open.begin ());
+      }
+      open.push_back (CoordinateList ());
+      open.back ().push_back (Coordinate (x1, y1));
+      open.back ().push_back (Coordinate (x2, y2));
+    }
+
+    // these do not affect how lines are drawn
+    void fill_color (const std::string &name) { target.fill_color (name); }
+    void fill_opacity (int op) { target.fill_opacity (op); }
+    void font (const std::string &name) { target.font (name); }
+    void point_size (int size) { target.point_size (size); }
+
+    void bezier (const CoordinateList &points) { flush (); target.bezier (points); }
+    void polygon (const CoordinateList &points) { flush (); target.polygon (points); }
+    void polyline (const CoordinateList &points) { flush (); target.polyline (points); }
+    void pop (void) { flush (); target.pop (); }
+    void push (void) { flush (); target.push (); }
+    void scaling (double hscale, double vscale) { flush (); target.scaling (hscale, vscale); }
+    void translate (double dx, double dy) { flush (); target.translate (dx, dy); }
+    void stroke_color (const std::string &name) { flush (); target.stroke_color (name); }
+    void stroke_width (int w) { flush (); target.stroke_width (w); }
+    void text (int x, int y, const std::string &text) { flush (); target.text (x, y, text); }
+    void drawrect (int x1, int y1, int x2, int y2) { flush (); target.drawrect (x1, y1, x2, y2); }
+    void row (int y) { flush (); target.row (y); }
+  };
+};
+
+// ------------------------------------------------------------
+
+static void render_common (gc& gc, const timing::data &d, int labelWidth,
+    			   double hscale, double vscale,
+			   unsigned from, unsigned to, const viewport &view) {
+
+  gc.push ();
+  if (!view.empty ())
+    gc.translate (-view.x, -view.y);
   gc.scaling (hscale, vscale);
   gc.font (vFont);
   gc.point_size (vFontPointsize);
   gc.stroke_width (vLineWidth);
   gc.stroke_color (timing::vColor_Fg);
 
-  int labelWidth = label_width (d);
+  visible_area area (view, hscale, vscale);
+  int left = labelWidth + vCellWtsep;
+  int right = left + vCellW * (to - from);
+  unsigned vfrom, vto;
+  area.cycles (left, from, to, vfrom, vto);
+
+  // labels are drawn from cycle lfrom on, as far back as the widest
+  // one could reach into the viewport from
+  unsigned lfrom = vfrom;
+  if (vfrom > from && vfrom < vto) {
+    double widest = 0;
+    for (unsigned k = 0; k < d.texts.size (); ++ k)
+      widest = max (widest, vMetrics.width (vFont, vFontPointsize, d.texts[k]));
+    unsigned back = (unsigned) ceil ((widest + vCellW/4) / vCellW);
+    lfrom = vfrom - min (back, vfrom - from);
+  }
 
   // draw a "scope-like" diagram for each signal
-  map<signame,int> ypos;
+  vector<int> ypos (d.signals.size ());
   int y = 0;
   const int num_row_colors = 4;
   string row_colors[] = { "white","grey", "white","CornflowerBlue"};
   int cur_row_color_idx = 0;
-  for (signal_sequence::const_iterator i = d.sequence.begin ();
-       i != d.sequence.end (); ++ i) {
-    const sigdata &sig = d.find_signal (*i);
-    ypos[*i] = y;
-    int x = labelWidth + vCellWtsep;
+  for (sigid i = 0; i < d.signals.size (); ++ i) {
+    const sigdata &sig = d.signals[i];
+    ypos[i] = y;
+    gc.row (y);
+    int rowHeight = vCellHt + vCellHdel * sig.maxdelays;
+    y += rowHeight;
+    string cur_row_color = row_colors[cur_row_color_idx];
+    cur_row_color_idx = (cur_row_color_idx + 1) % num_row_colors;
+    if (!area.overlaps (0, ypos[i], right, ypos[i] + rowHeight))
+      continue;
+
+    int x = left + vCellW * (vfrom - from);
     if (gc.highlightRows) {
-      string cur_row_color = row_colors[cur_row_color_idx];
       gc.stroke_color (cur_row_color);
       gc.fill_color(cur_row_color);
-      gc.drawrect(0,y,x+sig.data.size()*vCellW,y+vCellHt);
+      gc.drawrect(0,ypos[i],right,ypos[i]+vCellHt);
       gc.stroke_color ("black");
       gc.fill_color("black");
-      cur_row_color_idx++;
-      cur_row_color_idx = cur_row_color_idx%num_row_colors;
     }
-    push_text (gc, vCellWrm, y + vCellHtxt, *i);
-    sigvalue last;
-    for (value_sequence::const_iterator j = sig.data.begin ();
-	 j != sig.data.end (); ++ j) {
-      draw_transition (gc, x, y, last, *j);
-      last = *j;
-      x += vCellW;
+    if (area.x0 < left)
+      push_text (gc, vCellWrm, ypos[i] + vCellHtxt, d.names[i]);
+    sigvalue last, value;
+    unsigned start, length;
+    if (lfrom > 0)
+      last = sig.at (lfrom - 1);
+
+    // the labels of states left of the viewport may reach into it
+    run_cursor before (sig, lfrom, vfrom);
+    for (int lx = left + vCellW * (lfrom - from); before.next (value, start, length);
+	 lx += vCellW * length) {
+      if (value.type == STATE && value != last) {
+	run_cursor rest (sig, start + length, to);
+	draw_label (gc, lx, ypos[i], last, value, state_label (d, value, rest, length));
+      }
+      last = value;
+    }
+
+    run_cursor runs (sig, vfrom, vto);
+    while (runs.next (value, start, length)) {
+      std::string label;
+      if (value.type == STATE && value != last) {
+	// measured over the whole range, not just the visible cycles
+	run_cursor rest (sig, start + length, to);
+	label = state_label (d, value, rest, length);
+      }
+      for (; length > 0; -- length) {
+	if (!gc.cell (cell_shape (last, value), x, ypos[i])) {
+	  draw_transition (gc, x, ypos[i], last, value);
+	  gc.end_cell ();
+	}
+	draw_label (gc, x, ypos[i], last, value, label);
+	last = value;
+	x += vCellW;
+      }
     }
-    y += vCellHt + vCellHdel * sig.maxdelays;
   }
 
-  // draw the smooth arrows indicating the triggers for signal changes
-  for (list<depdata>::const_iterator i = d.dependencies.begin ();
-       i != d.dependencies.end (); ++ i)
-    draw_dependency (gc, labelWidth + vCellWtsep + vCellWrm + vCellW * i->n_trigger,
-                     vCellHt/2 + ypos[i->trigger],
-		     labelWidth + vCellWtsep + vCellWrm + vCellW * i->n_effect,
-                     vCellHt/2 + ypos[i->effect]);
+  // draw the smooth arrows indicating the triggers for signal changes.
+  // Arrows leaving the rendered cycles are cut off at its edge.
+  for (vector<depdata>::const_iterator i = d.dependencies.begin ();
+       i != d.dependencies.end (); ++ i) {
+    arrow_span span (i->n_trigger, i->n_effect, from, to, left, right);
+    if (!span.visible)
+      continue;
+    int y0 = vCellHt/2 + ypos[i->trigger], y1 = vCellHt/2 + ypos[i->effect];
+    if (!area.overlaps (min (span.x0, span.x1), min (y0, y1) - vCellHt/2,
+			max (span.x0, span.x1), max (y0, y1) + vCellHt/2))
+      continue;
+    draw_dependency (gc, span.x0, y0, span.x1, y1, span.effect_shown);
+    if (!span.trigger_shown)
+      draw_cut (gc, span.x0, y0);
+    if (!span.effect_shown)
+      draw_cut (gc, span.x1, y1);
+  }
 
   // draw the timing delay annotations
-  for (list<delaydata>::const_iterator i = d.delays.begin ();
-       i != d.delays.end (); ++ i)
-    draw_delay (gc, labelWidth + vCellWtsep + vCellWrm + vCellW * i->n_trigger,
-                vCellHt/2 + ypos[i->trigger],
-		labelWidth + vCellWtsep + vCellWrm + vCellW * i->n_effect,
-                vCellHt/2 + ypos[i->effect],
-		ypos[i->trigger] + vCellHt + vCellHdel * i->offset + vCellHtdel,
-                i->text);
+  for (vector<delaydata>::const_iterator i = d.delays.begin ();
+       i != d.delays.end (); ++ i) {
+    arrow_span span (i->n_trigger, i->n_effect, from, to, left, right);
+    if (!span.visible)
+      continue;
+    int y0 = vCellHt/2 + ypos[i->trigger], y1 = vCellHt/2 + ypos[i->effect];
+    int y2 = ypos[i->trigger] + vCellHt + vCellHdel * i->offset + vCellHtdel;
+    if (!area.overlaps (min (span.x0, span.x1), min (min (y0, y1), y2) - vCellHt/2,
+			max (span.x0, span.x1) + vCellW * 4, max (max (y0, y1), y2)))
+      continue;
+    draw_delay (gc, span.x0, y0, span.x1, y1, y2,
+		i->text, span.trigger_shown, span.effect_shown);
+    if (!span.trigger_shown)
+      draw_cut (gc, span.x0, y2);
+    if (!span.effect_shown)
+      draw_cut (gc, span.x1, y2);
+  }
 
   gc.pop ();
 }
 
 // ------------------------------------------------------------
 
-void timing::render (gc &gc, const data &d, double scale, bool highlightRows) {
+void timing::render (gc &gc, const data &d, double scale, bool highlightRows,
+		     unsigned from, unsigned to, const viewport &view) {
+  if (to > d.maxlen)
+    to = d.maxlen;
+  if (from > to)
+    from = to;
+
+  int labelWidth = label_width (d);
   int base_width, base_height;
-  base_size (d, base_width, base_height);
+  base_size (d, labelWidth, from, to, base_width, base_height);
 
-  gc.width = (int)(scale * base_width);
-  gc.height = (int)(scale * base_height);
+  gc.width = view.empty () ? (int)(scale * base_width) : view.w;
+  gc.height = view.empty () ? (int)(scale * base_height) : view.h;
   gc.highlightRows = highlightRows;
 
-  render_common (gc, d, scale, scale);
+  if (gc.caches_cells ())
+    render_common (gc, d, labelWidth, scale, scale, from, to, view);
+  else {
+    polyline_gc lines (gc);
+    render_common (lines, d, labelWidth, scale, scale, from, to, view);
+  }
 }
 
 // ------------------------------------------------------------
 
-void timing::render (gc &gc, const data &d, int w, int h, bool fixAspect, bool highlightRows) {
+void timing::render (gc &gc, const data &d, int w, int h, bool fixAspect, bool highlightRows,
+		     unsigned from, unsigned to, const viewport &view) {
+  if (to > d.maxlen)
+    to = d.maxlen;
+  if (from > to)
+    from = to;
+
+  int labelWidth = label_width (d);
   int base_width, base_height;
-  base_size (d, base_width, base_height);
+  base_size (d, labelWidth, from, to, base_width, base_height);
 
-  gc.width = w;
-  gc.height = h;
+  gc.width = view.empty () ? w : view.w;
+  gc.height = view.empty () ? h : view.h;
   gc.highlightRows = highlightRows;
 
   double hscale = w / (double)base_width;
@@ -700,137 +1374,343 @@ void timing::render (gc &gc, const data &d, int w, int h, bool fixAspect, bool h
       hscale = vscale = min (hscale, vscale);
   }
 
-  render_common (gc, d, hscale, vscale);
+  if (gc.caches_cells ())
+    render_common (gc, d, labelWidth, hscale, vscale, from, to, view);
+  else {
+    polyline_gc lines (gc);
+    render_common (lines, d, labelWidth, hscale, vscale, from, to, view);
+  }
 }
 
 // ------------------------------------------------------------
 
 #ifndef LITE
+magick_gc::magick_gc (void) : margin (0), threads (1) {
+  ymap.push_back (make_pair (1.0, 0.0));
+}
+
 magick_gc::~magick_gc (void) {
 }
 
 // ------------------------------------------------------------
 
+void magick_gc::add (const Magick::Drawable &d) {
+  drawables.push_back (d);
+  extents.push_back (make_pair (-1e30, 1e30));
+}
+
+void magick_gc::add (const Magick::Drawable &d, double top, double bottom) {
+  // from user units to output pixels
+  const pair<double, double> &m = ymap.back ();
+  top = m.first * (top - margin) + m.second;
+  bottom = m.first * (bottom + margin) + m.second;
+  drawables.push_back (d);
+  extents.push_back (make_pair (min (top, bottom), max (top, bottom)));
+}
+
+void magick_gc::add (const Magick::Drawable &d, const Magick::CoordinateList &points) {
+  double top = 1e30, bottom = -1e30;
+  for (Magick::CoordinateList::const_iterator i = points.begin ();
+       i != points.end (); ++ i) {
+    top = min (top, i->y ());
+    bottom = max (bottom, i->y ());
+  }
+  add (d, top, bottom);
+}
+
+// ------------------------------------------------------------
+
 void magick_gc::bezier (const Magick::CoordinateList &points) {
-  drawables.push_back (DrawableBezier (points));
+  add (DrawableBezier (points), points);
 }
 
 // ------------------------------------------------------------
 
 void magick_gc::fill_color (const std::string &name) {
-  drawables.push_back (DrawableFillColor (name));
+  add (DrawableFillColor (name));
 }
 
 // ------------------------------------------------------------
 
 void magick_gc::fill_opacity (int op) {
-  drawables.push_back (DrawableFillOpacity (op));
+  add (DrawableFillOpacity (op));
 }
 
 // ------------------------------------------------------------
 
 void magick_gc::font (const std::string& name) {
-  drawables.push_back (DrawableFont (name));
+  add (DrawableFont (name));
 }
 
 // ------------------------------------------------------------
 
 void magick_gc::line (int x1, int y1, int x2, int y2) {
-  drawables.push_back (DrawableLine (x1, y1, x2, y2));
+  add (DrawableLine (x1, y1, x2, y2), y1, y2);
 }
 
 void magick_gc::drawrect(int x1, int y1, int x2, int y2) {
-  drawables.push_back (DrawableRectangle (x1,y1,x2,y2));
+  add (DrawableRectangle (x1,y1,x2,y2), y1, y2);
 }
 
 // ------------------------------------------------------------
 
 void magick_gc::point_size (int size) {
-  drawables.push_back (DrawablePointSize (size));
+  margin = max (margin, size);
+  add (DrawablePointSize (size));
 }
 
 // ------------------------------------------------------------
 
 void magick_gc::polygon (const Magick::CoordinateList &points)
 {
-  drawables.push_back (DrawablePolygon (points));
+  add (DrawablePolygon (points), points);
 }
 
 // ------------------------------------------------------------
 
 void magick_gc::pop (void)
 {
-  drawables.push_back (DrawablePopGraphicContext ());
+  if (ymap.size () > 1)
+    ymap.pop_back ();
+  add (DrawablePopGraphicContext ());
 }
 
 // ------------------------------------------------------------
 
 void magick_gc::push (void)
 {
-  drawables.push_back (DrawablePushGraphicContext ());
+  ymap.push_back (ymap.back ());
+  add (DrawablePushGraphicContext ());
 }
 
 // ------------------------------------------------------------
 
 void magick_gc::scaling (double hscale, double vscale)
 {
-  drawables.push_back (DrawableScaling (hscale, vscale));
+  ymap.back ().first *= vscale;
+  add (DrawableScaling (hscale, vscale));
+}
+
+// ------------------------------------------------------------
+
+void magick_gc::translate (double dx, double dy)
+{
+  ymap.back ().second += ymap.back ().first * dy;
+  add (DrawableTranslation (dx, dy));
 }
 
 // ------------------------------------------------------------
 
 void magick_gc::stroke_color (const std::string& name)
 {
-  drawables.push_back (DrawableStrokeColor (name));
+  add (DrawableStrokeColor (name));
 }
 
 // ------------------------------------------------------------
 
 void magick_gc::stroke_width (int w)
 {
-  drawables.push_back (DrawableStrokeWidth (w));
+  margin = max (margin, w);
+  add (DrawableStrokeWidth (w));
 }
 
 // ------------------------------------------------------------
 
 void magick_gc::text (int x, int y, const std::string &text)
 {
-  drawables.push_back (DrawableText (x, y, text));
+  // the text lies above its baseline, apart from descenders
+  add (DrawableText (x, y, text), y - margin, y);
+}
+
+// ------------------------------------------------------------
+// ImageMagick fills polylines as polygons, so without a fill
+
+void magick_gc::polyline (const Magick::CoordinateList &points)
+{
+  add (DrawablePushGraphicContext ());
+  add (DrawableFillColor ("none"));
+  add (DrawablePolyline (points), points);
+  add (DrawablePopGraphicContext ());
+}
+
+// ------------------------------------------------------------
+
+void magick_gc::row (int y)
+{
+  rows.push_back ((int) (ymap.back ().first * y + ymap.back ().second));
+}
+
+// ------------------------------------------------------------
+
+namespace {
+
+  // one band of the canvas, drawn on its own thread
+  struct band {
+    Magick::Image img;
+    std::vector<Magick::Drawable> drawables;
+    int top;
+    std::string error;
+  };
+};
+
+static void *draw_band (void *arg) {
+  band *b = (band *) arg;
+  try {
+    b->img.draw (b->drawables);
+  }
+  catch (Magick::Exception &err) {
+    b->error = err.what ();
+  }
+  return NULL;
 }
 
 // ------------------------------------------------------------
 
 void magick_gc::draw (Magick::Image& img) const
 {
-  img.draw (drawables);
+  // the bands begin at the signal rows closest to equal heights
+  std::vector<int> edges (1, 0);
+#ifdef HAVE_PTHREAD_H
+  for (int k = 1; k < threads; ++ k) {
+    std::vector<int>::const_iterator i =
+      lower_bound (rows.begin (), rows.end (), height * k / threads);
+    if (i != rows.end () && *i > edges.back () && *i < height)
+      edges.push_back (*i);
+  }
+#endif /* HAVE_PTHREAD_H */
+  if (edges.size () == 1) {
+    img.draw (drawables);
+    return;
+  }
+  edges.push_back (height);
+
+  // drawables overlapping more than one band are drawn in each of them
+  std::vector<band> bands (edges.size () - 1);
+  for (unsigned k = 0; k < bands.size (); ++ k) {
+    band &b = bands[k];
+    b.top = edges[k];
+    b.img = Image (Geometry (width, edges[k + 1] - edges[k]), timing::vColor_Bg);
+    b.drawables.push_back (DrawableTranslation (0, -b.top));
+    for (unsigned i = 0; i < drawables.size (); ++ i)
+      if (extents[i].second >= edges[k] && extents[i].first <= edges[k + 1])
+	b.drawables.push_back (drawables[i]);
+  }
+
+#ifdef HAVE_PTHREAD_H
+  std::vector<pthread_t> ids (bands.size ());
+  std::vector<bool> started (bands.size ());
+  for (unsigned k = 1; k < bands.size (); ++ k)
+    started[k] = pthread_create (&ids[k], NULL, draw_band, &bands[k]) == 0;
+  draw_band (&bands[0]);
+  for (unsigned k = 1; k < bands.size (); ++ k)
+    if (started[k])
+      pthread_join (ids[k], NULL);
+    else
+      draw_band (&bands[k]);
+#endif /* HAVE_PTHREAD_H */
+
+  for (unsigned k = 0; k < bands.size (); ++ k) {
+    if (!bands[k].error.empty ())
+      throw Magick::Exception (bands[k].error);
+    img.composite (bands[k].img, 0, bands[k].top, CopyCompositeOp);
+  }
 }
 
 #endif /* ! LITE */
 
+// ------------------------------------------------------------
+// the body of the document draws with these short procedures
+static const char ps_prolog[] =
+  "%%BeginProlog\n"
+  "/m {newpath moveto} bind def\n"
+  "/l /lineto load def\n"
+  "/c /curveto load def\n"
+  "/s /stroke load def\n"
+  "/L {newpath moveto lineto stroke} bind def\n"
+  "/G {closepath gsave stroke grestore fill} bind def\n"
+  "/T {newpath moveto show} bind def\n"
+  "/C /setrgbcolor load def\n"
+  "/W /setlinewidth load def\n"
+  "/F {exch findfont exch scalefont setfont} bind def\n"
+  "/S /save load def\n"
+  "/R /restore load def\n"
+  "%%EndProlog\n";
+
+namespace {
+
+  // a number in as few characters as it takes: integers in full,
+  // anything else to three decimals without trailing zeros
+  struct ps_num {
+    double v;
+    ps_num (double x) : v (x) { }
+  };
+
+  std::ostream &operator<< (std::ostream &o, const ps_num &n) {
+    char buf[32];
+    if (n.v == floor (n.v) && fabs (n.v) < 1e15)
+      sprintf (buf, "%.0f", n.v);
+    else {
+      sprintf (buf, "%.3f", n.v);
+      char *e = buf + strlen (buf);
+      while (e[-1] == '0')
+	-- e;
+      if (e[-1] == '.')
+	-- e;
+      *e = 0;
+      if (!strcmp (buf, "-0"))
+	strcpy (buf, "0");
+    }
+    return o << buf;
+  }
+};
+
 // ------------------------------------------------------------
 
-postscript_gc::postscript_gc (void) {
+postscript_gc::postscript_gc (std::ostream &o, bool e)
+  : out (o), eps (e), begun (false), font_name ("Helvetica"), font_size (12),
+    page_count (0), pages (0) {
 }
 
 postscript_gc::~postscript_gc (void) {
 }
 
+// ------------------------------------------------------------
+// the header goes out with the first call, once render() has set the
+// size for the bounding box
+
+std::ostream &postscript_gc::ps (void) {
+  if (!begun) {
+    if (eps) {
+      out << "%!PS-Adobe-3.0 EPSF-3.0\n";
+      out << "%%BoundingBox: 0 0 " << width << ' ' << height << '\n';
+    } else
+      out << "%!PS-Adobe-3.0\n";
+    if (pages > 0)
+      out << "%%Pages: " << pages << '\n';
+    out << ps_prolog;
+    begun = true;
+  }
+  return out;
+}
+
+// ------------------------------------------------------------
+
+void postscript_gc::point (double x, double y) {
+  ps () << ps_num (x) << ' ' << ps_num (height - y);
+}
+
 // ------------------------------------------------------------
 
 void postscript_gc::bezier (const Magick::CoordinateList &points) {
   std::vector<Magick::Coordinate>::const_iterator i = points.begin();
 
-  ps_text << "newpath\n";
-  ps_text << i->x () << ' ' << (height - i->y ()) << " moveto\n";
-  i++;
-
-  while (i != points.end ()) {
-    ps_text << i->x () << ' ' << (height - i->y ()) << "\n";
-    ++i;
+  point (i->x (), i->y ());
+  ps () << " m";
+  for (++ i; i != points.end (); ++ i) {
+    ps () << ' ';
+    point (i->x (), i->y ());
   }
-
-  ps_text << "curveto\n";
-  ps_text << "stroke\n";
+  ps () << " c s\n";
 }
 
 // ------------------------------------------------------------
@@ -841,22 +1721,37 @@ void postscript_gc::fill_color (const std::string& name) {
 
 // ------------------------------------------------------------
 
-void postscript_gc::fill_opacity (int op) {
+void postscript_gc::fill_opacity (int) {
 }
 
 // ------------------------------------------------------------
+// a font is set together with its size
 
 void postscript_gc::font (const std::string& name) {
-  ps_text << '/' << name << " findfont\n";
+  font_name = name;
+  ps () << '/' << font_name << ' ' << font_size << " F\n";
 }
 
 // ------------------------------------------------------------
 
 void postscript_gc::line (int x1, int y1, int x2, int y2) {
-  ps_text << "newpath\n";
-  ps_text << x1 << ' ' << (height - y1) << " moveto\n";
-  ps_text << x2 << ' ' << (height - y2) << " lineto\n";
-  ps_text << "stroke\n";
+  point (x2, y2);
+  ps () << ' ';
+  point (x1, y1);
+  ps () << " L\n";
+}
+
+void postscript_gc::polyline (const Magick::CoordinateList &points) {
+  Magick::CoordinateList::const_iterator i = points.begin ();
+
+  point (i->x (), i->y ());
+  ps () << " m";
+  for (++ i; i != points.end (); ++ i) {
+    ps () << ' ';
+    point (i->x (), i->y ());
+    ps () << " l";
+  }
+  ps () << " s\n";
 }
 
 void postscript_gc::drawrect(int x1, int y1, int x2, int y2) {
@@ -873,63 +1768,64 @@ void postscript_gc::drawrect(int x1, int y1, int x2, int y2) {
 // ------------------------------------------------------------
 
 void postscript_gc::point_size (int size) {
-  ps_text << size << " scalefont\nsetfont\n";
+  font_size = size;
+  ps () << '/' << font_name << ' ' << font_size << " F\n";
 }
 
 // ------------------------------------------------------------
+// outlined and filled in the one colour, from a single path
 
 void postscript_gc::polygon (const Magick::CoordinateList &points) {
-  static const char *ops[] = {"stroke", "fill"};
-  Magick::CoordinateList::const_iterator i;
-  int j;
-
-  for (j = 0; j < 2; j++) {
-    ps_text << "newpath\n";
-    i = points.begin();
-    ps_text << i->x () << ' ' << (height - i->y ()) << " moveto\n";
-    i++;
-
-    while (i != points.end ()) {
-      ps_text << i->x () << ' ' << (height - i->y ()) << " lineto\n";
-      ++i;
-    }
-
-    ps_text << "closepath\n";
-    ps_text << ops[j] << '\n';
+  Magick::CoordinateList::const_iterator i = points.begin ();
+
+  point (i->x (), i->y ());
+  ps () << " m";
+  for (++ i; i != points.end (); ++ i) {
+    ps () << ' ';
+    point (i->x (), i->y ());
+    ps () << " l";
   }
+  ps () << " G\n";
 }
 
 // ------------------------------------------------------------
 
 void postscript_gc::pop (void) {
-  ps_text << "restore\n";
+  ps () << "R\n";
 }
 
 // ------------------------------------------------------------
 
 void postscript_gc::push (void) {
-  ps_text << "save\n";
+  ps () << "S\n";
 }
 
 // ------------------------------------------------------------
 
 void postscript_gc::scaling (double hscale, double vscale) {
-  ps_text << hscale << ' ' << vscale << " scale\n";
+  ps () << ps_num (hscale) << ' ' << ps_num (vscale) << " scale\n";
+}
+
+// ------------------------------------------------------------
+
+void postscript_gc::translate (double dx, double dy) {
+  // y runs upwards in postscript
+  ps () << ps_num (dx) << ' ' << ps_num (0.0 - dy) << " translate\n";
 }
 
 // ------------------------------------------------------------
 
 void postscript_gc::stroke_color (const std::string& name) {
   if (name == "black")
-    ps_text << "0.0 0.0 0.0 setrgbcolor\n";
+    ps () << "0 0 0 C\n";
   else
-    ps_text << "0.0 0.0 1.0 setrgbcolor\n";
+    ps () << "0 0 1 C\n";
 }
 
 // ------------------------------------------------------------
 
 void postscript_gc::stroke_width (int w) {
-  ps_text << w << " setlinewidth\n";
+  ps () << w << " W\n";
 }
 
 // ------------------------------------------------------------
@@ -937,60 +1833,51 @@ void postscript_gc::stroke_width (int w) {
 void postscript_gc::text (int x, int y, const std::string& text) {
   unsigned int i;
 
-  ps_text << "newpath\n";
-  ps_text << x << ' ' << (height - y) << " moveto\n";
-
-  ps_text << '(';
+  ps () << '(';
   for (i = 0; i < text.size(); i++) {
     char c = text[i];
 
-    if (c == '(' || c == ')')
-      ps_text << '\\';
-    ps_text << c;
+    if (c == '(' || c == ')' || c == '\\')
+      ps () << '\\';
+    ps () << c;
   }
 
-  ps_text << ')' << " show\n";
+  ps () << ") ";
+  point (x, y);
+  ps () << " T\n";
 }
 
 // ------------------------------------------------------------
 
-static std::string filename_ext(const std::string &fname)
-{
-  int i = fname.size () - 1;
+// each page is drawn by a render() of its own
 
-  while (i >= 0 && fname[i] != '.')
-    i--;
-
-  return std::string (fname, i + 1);
+void postscript_gc::page (void) {
+  ps ();
+  if (page_count > 0)
+    out << "showpage\n";
+  ++ page_count;
+  out << "%%Page: " << page_count << ' ' << page_count << '\n';
 }
 
 // ------------------------------------------------------------
 
-void postscript_gc::print (std::ostream& out) const {
-  out << ps_text.str();
+void postscript_gc::finish (void) {
+  ps ();
+  if (!eps)
+    out << "showpage\n";
+  out << "%%EOF\n";
 }
 
 // ------------------------------------------------------------
 
-void postscript_gc::print (const std::string& filename) const {
-  std::ofstream out;
-
-  out.exceptions (ofstream::failbit | ofstream::badbit);
-  out.open (filename.c_str());
-
-  std::string ext = filename_ext (filename);
+static std::string filename_ext(const std::string &fname)
+{
+  int i = fname.size () - 1;
 
-  if (!strcasecmp (ext.c_str (), "eps")) {
-    out << "%!PS-Adobe-3.0 EPSF-3.0\n";
-    out << "%%BoundingBox: 0 0 " << width << ' ' << height << '\n';
-    print (out);
-  } else {
-    out << "%!PS-Adobe-3.0\n";
-    print (out);
-    out << "showpage\n";
-  }
+  while (i >= 0 && fname[i] != '.')
+    i--;
 
-  out << "%%EOF\n";
+  return std::string (fname, i + 1);
 }
 
 // ------------------------------------------------------------
@@ -1001,3 +1888,7 @@ bool postscript_gc::has_ps_ext (const std::string &filename) {
   return !(strcasecmp (ext.c_str (), "ps") &&
     	   strcasecmp (ext.c_str (), "eps"));
 }
+
+bool postscript_gc::has_eps_ext (const std::string &filename) {
+  return !strcasecmp (filename_ext (filename).c_str (), "eps");
+}
@@ -20,8 +20,9 @@
 #ifndef __TIMING_H
 #define __TIMING_H
 #include <string>
-#include <list>
 #include <map>
+#include <deque>
+#include <vector>
 #include <iostream>
 #include <sstream>
 #include <exception>
@@ -30,7 +31,6 @@
 
 #else /* LITE */
 
-#include <vector>
 namespace Magick {
   class Coordinate {
   public:
@@ -64,21 +64,93 @@ namespace timing {
 
   enum valuetype {UNDEF, ZERO, ONE, X, Z, PULSE, TICK, STATE};
 
+  // value texts are interned in data::texts; the texts of the implied
+  // padding values are always present
+  enum {TEXT_X, TEXT_ZERO};
+
+  // the text of an UNDEF value, which no interned text can have
+  const unsigned TEXT_NONE = ~0u;
+
   struct sigvalue {
     valuetype type;
-    std::string text;
+    unsigned text;		// index into data::texts
     sigvalue (void);
-    sigvalue (const sigvalue &);
-    sigvalue (const std::string &s, valuetype n = UNDEF);
-    sigvalue &operator= (const sigvalue &);
+    sigvalue (valuetype n, unsigned t);
+    bool operator== (const sigvalue &) const;
+    bool operator!= (const sigvalue &) const;
+  };
+
+  // a value held for 'length' consecutive cycles beginning at 'start'
+  struct sigrun {
+    sigvalue value;
+    unsigned start, length;
   };
 
   typedef std::string signame;
-  typedef std::list<signame> signal_sequence;
-  typedef std::list<sigvalue> value_sequence;
+  typedef unsigned sigid;
+  typedef std::vector<sigid> signal_sequence;
+  typedef std::vector<sigrun> run_sequence;
+
+  // the id of a signal which was left out by the signal_filter
+  const sigid no_signal = ~0u;
+
+  // assigns dense integer ids to strings in order of first appearance.
+  // A released id is given to the next new string.  Strings can be
+  // looked up by their bytes, so that the parser needs no copy of a
+  // token to find it.
+  class string_table {
+    struct span {
+      const char *p;
+      size_t n;
+      span (const char *p_, size_t n_) : p (p_), n (n_) { }
+      bool operator< (const span &s) const;
+    };
+    std::deque<std::string> strings;	// the spans in index point here
+    std::map<span, unsigned> index;
+    std::vector<unsigned> unused;	// released ids
+  public:
+    string_table (void) { }
+    string_table (const string_table &t);
+    string_table &operator= (const string_table &t);
+    unsigned intern (const std::string &s) { return intern (s.data (), s.size ()); }
+    unsigned intern (const char *s, size_t n);
+    void release (unsigned id);
+    bool find (const std::string &s, unsigned &id) const { return find (s.data (), s.size (), id); }
+    bool find (const char *s, size_t n, unsigned &id) const;
+    const std::string &operator[] (unsigned id) const { return strings[id]; }
+    unsigned size (void) const { return strings.size (); }
+  };
+
+  // selects signals by name with shell style wildcards, '*' and '?'.
+  // A name is kept when it matches one of the included patterns, or
+  // there are none, and none of the excluded ones.
+  struct signal_filter {
+    std::vector<std::string> include, exclude;
+    bool selected (const signame &name) const;
+  };
+
+  // text widths by font, point size and text.  Each one is measured
+  // only once, and the table can be kept in a file between runs.  It
+  // may be used from several threads at once.
+  class font_metrics {
+    std::map<std::string, double> widths;
+    std::string key;		// of the last lookup, see width
+    bool changed;
+#ifndef LITE
+    Magick::Image *img;
+#endif /* ! LITE */
+  public:
+    font_metrics (void);
+    ~font_metrics ();
+    double width (const std::string &font, int size, const std::string &text);
+    void load (const std::string &filename);
+    void save (const std::string &filename);
+  };
 
   extern int vFontPointsize, vLineWidth, vCellHt, vCellW;
   extern std::string vFont, vColor_Bg, vColor_Fg, vColor_Dep;
+  extern bool vFitText;
+  extern font_metrics vMetrics;
 
   class exception : public std::exception {
   };
@@ -91,48 +163,102 @@ namespace timing {
     const char *what (void) const throw ();
   };
 
+  class bad_color : public exception {
+    std::string text;
+  public:
+    bad_color (const std::string &name) throw ();
+    ~bad_color () throw ();
+    const char *what (void) const throw ();
+  };
+
+  class bad_file : public exception {
+    std::string text;
+  public:
+    bad_file (const std::string &filename, const char *msg) throw ();
+    ~bad_file () throw ();
+    const char *what (void) const throw ();
+  };
+
   struct depdata {
-    signame trigger;		// name of trigger signal
-    signame effect;		// name of effect signal
+    sigid trigger;		// id of trigger signal
+    sigid effect;		// id of effect signal
     unsigned n_trigger;		// sequence number of trigger signal
     unsigned n_effect;		// sequence number for effect signal
   };
 
   struct delaydata {
     std::string text;
-    signame trigger;		// name of trigger signal
-    signame effect;		// name of effect signal
+    sigid trigger;		// id of trigger signal
+    sigid effect;		// id of effect signal
     unsigned n_trigger;		// sequence number of trigger signal
     unsigned n_effect;		// sequence number for effect signal
     int offset;			// prevent arrows from overlapping
   };
 
+  // only the cycles which were set are stored.  Cycles before the
+  // first run are X, and cycles in the gap after a run, or beyond the
+  // last one up to data::maxlen, hold its value (a pulse becomes 0).
   struct sigdata {
-    value_sequence data;
+    run_sequence runs;		// ordered by start
     int numdelays, maxdelays;
     sigdata (void);
-    sigdata (const sigdata &);
-    sigdata &operator= (const sigdata &);
+    unsigned length (void) const;
+    run_sequence::const_iterator find (unsigned n) const;
+    sigvalue at (unsigned n) const;
+    void set (unsigned n, const sigvalue &value);
+    static sigvalue held (const sigvalue &last);
   };
 
-  typedef std::map<signame, sigdata> signal_database;
+  // walks the cycles [from, to) of a signal as runs of equal values,
+  // including the implied ones
+  class run_cursor {
+    const sigdata &sig;
+    run_sequence::const_iterator i;
+    unsigned n, to;
+  public:
+    run_cursor (const sigdata &s, unsigned from, unsigned to);
+    bool next (sigvalue &value, unsigned &start, unsigned &length);
+  };
 
+  // signals are stored by id, which is also their display order.
+  // Signals rejected by the filter get no_signal as their id, and
+  // anything done to them is ignored.
   struct data {
     unsigned maxlen;
-    signal_database signals;
-    signal_sequence sequence;
-    std::list<depdata> dependencies;
-    std::list<delaydata> delays;
+    string_table names;
+    string_table texts;
+    signal_filter filter;
+    string_table dropped;	// names rejected by the filter
+    std::vector<sigdata> signals;
+    std::vector<depdata> dependencies;
+    std::vector<delaydata> delays;
     data (void);
-    data (const data &);
-    data &operator= (const data &);
+    sigid signal_id (const signame &name);
+    sigid signal_id (const char *name, size_t len);
+    sigvalue value (const std::string &s, valuetype n = UNDEF);
+    sigvalue value (const char *s, size_t len, valuetype n);
     sigdata &find_signal (const signame &name);
     const sigdata &find_signal (const signame &name) const;
-    void add_dependency (const signame &name, const signame &dep);
-    void add_dependencies (const signame &name, const signal_sequence &deps);
-    void add_delay (const signame &name, const signame &dep, const std::string &text);
-    void set_value (const signame &name, unsigned n, const sigvalue &value);
+    void add_dependency (sigid name, sigid dep);
+    void add_dependencies (sigid name, const signal_sequence &deps);
+    void add_delay (sigid name, sigid dep, const std::string &text);
+    void set_value (sigid name, unsigned n, const sigvalue &value);
     void pad (unsigned n);
+    void discard (unsigned n);
+  };
+
+  // compiled diagrams, see binary.cc.  read_binary needs an empty data,
+  // and leaves out the signals its filter rejects.
+  void write_binary (const data &d, const std::string &filename);
+  void read_binary (data &d, const std::string &filename);
+
+  // a rectangle of the rendered diagram in output pixels; an empty
+  // one stands for the whole diagram
+  struct viewport {
+    int x, y, w, h;
+    viewport (void) : x (0), y (0), w (0), h (0) { }
+    viewport (int x_, int y_, int w_, int h_) : x (x_), y (y_), w (w_), h (h_) { }
+    bool empty (void) const { return w <= 0 || h <= 0; }
   };
 
   class gc {
@@ -153,17 +279,47 @@ namespace timing {
     virtual void pop (void) = 0;
     virtual void push (void) = 0;
     virtual void scaling (double hscale, double vscale) = 0;
+    virtual void translate (double dx, double dy) = 0;
     virtual void stroke_color (const std::string &name) = 0;
     virtual void stroke_width (int w) = 0;
     virtual void text (int x, int y, const std::string &text) = 0;
     virtual void drawrect (int x1, int y1, int x2, int y2) = 0;
+
+    // connected, unfilled lines; by default drawn one by one
+    virtual void polyline (const Magick::CoordinateList &points);
+
+    // called as each signal row begins, with its y
+    virtual void row (int) { }
+
+    // a gc which caches cells keeps each shape of cell the first time
+    // it is drawn, between cell() and end_cell(), and later draws it
+    // itself where cell() is called with the same shape again, which
+    // it tells by returning true.  Labels are not part of the shape.
+    virtual bool caches_cells (void) const { return false; }
+    virtual bool cell (unsigned, int, int) { return false; }
+    virtual void end_cell (void) { }
   };
 
 #ifndef LITE
+  // draw() can split the canvas into bands of signal rows and draw
+  // them on separate threads.  The vertical extent of each drawable is
+  // kept for this, in output pixels; drawables which only change the
+  // drawing state extend over the whole canvas.
   class magick_gc : public gc {
     std::vector<Magick::Drawable> drawables;
+    std::vector<std::pair<double, double> > extents;
+    std::vector<int> rows;	// output y of each signal row
+    std::vector<std::pair<double, double> > ymap; // y scale and offset by context
+    int margin;			// largest stroke width or point size so far
+
+    void add (const Magick::Drawable &d);
+    void add (const Magick::Drawable &d, double top, double bottom);
+    void add (const Magick::Drawable &d, const Magick::CoordinateList &points);
 
   public:
+    int threads;
+
+    magick_gc (void);
     ~magick_gc (void);
 
     void bezier (const Magick::CoordinateList &points);
@@ -177,19 +333,34 @@ namespace timing {
     void pop (void);
     void push (void);
     void scaling (double hscale, double vscale);
+    void translate (double dx, double dy);
     void stroke_color (const std::string &name);
     void stroke_width (int w);
     void text (int x, int y, const std::string &text);
+    void polyline (const Magick::CoordinateList &points);
+    void row (int y);
 
     void draw (Magick::Image& img) const;
   };
 
 #endif /* ! LITE */
+  // draws with the short procedures of a prolog, see timing.cc.
+  // The document goes to the stream as it is drawn, and must be ended
+  // with finish().
   class postscript_gc : public gc {
-    std::ostringstream ps_text;
+    std::ostream &out;
+    bool eps, begun;
+    std::string font_name;
+    int font_size;
+    unsigned page_count;
+
+    std::ostream &ps (void);
+    void point (double x, double y);
 
   public:
-    postscript_gc (void);
+    unsigned pages;		// for the header, if known
+
+    postscript_gc (std::ostream &o, bool e = false);
     ~postscript_gc (void);
 
     void bezier (const Magick::CoordinateList &points);
@@ -203,22 +374,246 @@ namespace timing {
     void pop (void);
     void push (void);
     void scaling (double hscale, double vscale);
+    void translate (double dx, double dy);
     void stroke_color (const std::string &name);
     void stroke_width (int w);
     void text (int x, int y, const std::string &text);
+    void polyline (const Magick::CoordinateList &points);
 
-    void print (std::ostream& out) const;
-    void print (const std::string& filename) const;
+    void page (void);
+    void finish (void);
 
     static bool has_ps_ext (const std::string& filename);
+    static bool has_eps_ext (const std::string& filename);
+  };
+
+  // draws into its own pixel buffer, with a built-in bitmap font, and
+  // writes PNG or PPM files without ImageMagick; see raster.cc
+  class raster_gc : public gc {
+    struct state {
+      double sx, sy, tx, ty;	// user units to pixels
+      unsigned stroke, fill;	// 0xrrggbb
+      bool filled;
+      int stroke_width, point_size;
+    };
+    std::vector<state> states;
+    std::vector<unsigned> pixels;
+
+    // the spans of a cell, relative to its top left pixel
+    struct stamp_run {
+      int dy, x0, x1;
+      unsigned color;
+    };
+    struct stamp_key {
+      unsigned shape, stroke;
+      int stroke_width, fx, fy;	// fx, fy: the cell's offset within its pixel
+      double sx, sy;
+      bool operator< (const stamp_key &) const;
+    };
+    std::map<stamp_key, std::vector<stamp_run> > stamps;
+    std::vector<stamp_run> *recording;
+    int stamp_x, stamp_y;
+
+    unsigned *canvas (void);
+    void span (int y, double x0, double x1, unsigned color);
+    void fill_rect (double x0, double y0, double x1, double y1, unsigned color);
+    void fill_polygon (const std::vector<Magick::Coordinate> &points, unsigned color);
+    void stroke_line (double x1, double y1, double x2, double y2);
+    Magick::Coordinate map (double x, double y) const;
+
+  public:
+    raster_gc (void);
+    ~raster_gc (void);
+
+    void bezier (const Magick::CoordinateList &points);
+    void fill_color (const std::string &name);
+    void fill_opacity (int op);
+    void font (const std::string &name);
+    void line (int x1, int y1, int x2, int y2);
+    void drawrect (int x1, int y1, int x2, int y2);
+    void point_size (int size);
+    void polygon (const Magick::CoordinateList &points);
+    void pop (void);
+    void push (void);
+    void scaling (double hscale, double vscale);
+    void translate (double dx, double dy);
+    void stroke_color (const std::string &name);
+    void stroke_width (int w);
+    void text (int x, int y, const std::string &text);
+
+    bool caches_cells (void) const { return true; }
+    bool cell (unsigned shape, int x, int y);
+    void end_cell (void);
+
+    void print (const std::string &filename);
+
+    static unsigned parse_color (const std::string &name);
+    static bool has_raster_ext (const std::string &filename);
+  };
+
+  // writes SVG elements to the stream as they are drawn.  The document
+  // is begun by the first call after render() has set the size, and
+  // must be ended with finish(); see svg.cc
+  class svg_gc : public gc {
+    struct state {
+      double sx, sy, tx, ty;
+      std::string stroke, fill, font;
+      int fill_opacity, stroke_width, point_size;
+      bool operator== (const state &) const;
+    };
+    std::ostream &out;
+    std::vector<state> states;
+    state written;		// the style of the open group
+    bool begun, grouped;
+
+    std::ostream &element (void);
+
+  public:
+    svg_gc (std::ostream &o);
+    ~svg_gc (void);
+
+    void bezier (const Magick::CoordinateList &points);
+    void fill_color (const std::string &name);
+    void fill_opacity (int op);
+    void font (const std::string &name);
+    void line (int x1, int y1, int x2, int y2);
+    void drawrect (int x1, int y1, int x2, int y2);
+    void point_size (int size);
+    void polygon (const Magick::CoordinateList &points);
+    void pop (void);
+    void push (void);
+    void scaling (double hscale, double vscale);
+    void translate (double dx, double dy);
+    void stroke_color (const std::string &name);
+    void stroke_width (int w);
+    void text (int x, int y, const std::string &text);
+    void polyline (const Magick::CoordinateList &points);
+
+    void finish (void);
+
+    static bool has_svg_ext (const std::string &filename);
+  };
+
+  // writes a PDF document to the stream, a page at a time.  Each
+  // page() after the first begins a new one, and finish() ends the
+  // document; see pdf.cc
+  class pdf_gc : public gc {
+    struct state {
+      bool filled;
+      std::string font;
+      int point_size;
+    };
+    std::ostream &out;
+    std::streamoff written;
+    std::vector<std::streamoff> offsets; // of each object
+    std::vector<state> states;
+    std::ostringstream contents;	// of the page being drawn
+    bool page_open;
+    int page_width, page_height;
+    unsigned next_object;
+    std::vector<unsigned> pages;
+    std::vector<std::string> fonts;
+
+    void put (const std::string &s);
+    void begin_object (unsigned n);
+    std::ostream &content (void);
+    void end_page (void);
+    std::string font_resource (const std::string &name);
+    void path (const Magick::CoordinateList &points, const char *op);
+
+  public:
+    pdf_gc (std::ostream &o);
+    ~pdf_gc (void);
+
+    void bezier (const Magick::CoordinateList &points);
+    void fill_color (const std::string &name);
+    void fill_opacity (int op);
+    void font (const std::string &name);
+    void line (int x1, int y1, int x2, int y2);
+    void polyline (const Magick::CoordinateList &points);
+    void drawrect (int x1, int y1, int x2, int y2);
+    void point_size (int size);
+    void polygon (const Magick::CoordinateList &points);
+    void pop (void);
+    void push (void);
+    void scaling (double hscale, double vscale);
+    void translate (double dx, double dy);
+    void stroke_color (const std::string &name);
+    void stroke_width (int w);
+    void text (int x, int y, const std::string &text);
+
+    void page (void);
+    void finish (void);
+
+    static bool has_pdf_ext (const std::string &filename);
+  };
+
+  // keeps the calls made to it as a display list, which can be
+  // replayed into any other gc as often as needed, or saved to a file
+  // and loaded again; see display.cc and binary.cc
+  class recording_gc : public gc {
+    enum {OP_BEZIER, OP_FILL_COLOR, OP_FILL_OPACITY, OP_FONT, OP_LINE,
+	  OP_POLYLINE, OP_DRAWRECT, OP_POINT_SIZE, OP_POLYGON, OP_POP, OP_PUSH,
+	  OP_SCALING, OP_TRANSLATE, OP_STROKE_COLOR, OP_STROKE_WIDTH, OP_TEXT,
+	  OP_ROW, OP_COUNT};
+    std::vector<unsigned> ops;
+    std::vector<double> reals;
+    string_table strings;
+
+    void add (unsigned op, unsigned arg);
+    void add (unsigned op, int x1, int y1, int x2, int y2);
+    void add (unsigned op, const Magick::CoordinateList &points);
+    void add (unsigned op, double a, double b);
+    bool valid (void) const;
+
+  public:
+    recording_gc (void);
+    ~recording_gc (void);
+
+    void bezier (const Magick::CoordinateList &points);
+    void fill_color (const std::string &name);
+    void fill_opacity (int op);
+    void font (const std::string &name);
+    void line (int x1, int y1, int x2, int y2);
+    void drawrect (int x1, int y1, int x2, int y2);
+    void point_size (int size);
+    void polygon (const Magick::CoordinateList &points);
+    void pop (void);
+    void push (void);
+    void scaling (double hscale, double vscale);
+    void translate (double dx, double dy);
+    void stroke_color (const std::string &name);
+    void stroke_width (int w);
+    void text (int x, int y, const std::string &text);
+    void polyline (const Magick::CoordinateList &points);
+    void row (int y);
+
+    void replay (gc &target) const;
+    void save (const std::string &filename) const;
+    void load (const std::string &filename);
+
+    static bool has_dtl_ext (const std::string &filename);
   };
 
-  void render (gc &gc, const data &d, double scale, bool highlightRows);
-  void render (gc &gc, const data &d, int w, int h, bool fixAspect,bool highlightRows);
+  // render cycles [from, to) of the diagram, by default all of them.
+  // With a viewport, the gc gets its size and only what lies in it.
+  void render (gc &gc, const data &d, double scale, bool highlightRows,
+	       unsigned from = 0, unsigned to = ~0u,
+	       const viewport &view = viewport ());
+  void render (gc &gc, const data &d, int w, int h, bool fixAspect,bool highlightRows,
+	       unsigned from = 0, unsigned to = ~0u,
+	       const viewport &view = viewport ());
+
+  // heap allocations are counted by phase and reported on exit when
+  // configured with --enable-alloc-stats, see alloc_stats.cc
+#ifdef ALLOC_STATS
+  void alloc_phase (const char *name);
+#  define ALLOC_PHASE(name) timing::alloc_phase (name)
+#else
+#  define ALLOC_PHASE(name)
+#endif /* ALLOC_STATS */
 };
 
 std::ostream &operator<< (std::ostream &f, const timing::data &d);
-std::ostream &operator<< (std::ostream &f, const timing::sigdata &d);
-std::ostream &operator<< (std::ostream &f, const timing::depdata &d);
 
 #endif
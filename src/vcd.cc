@@ -0,0 +1,427 @@
+// This file is part of drawtiming.
+//
+// Drawtiming is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// Drawtiming is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with drawtiming; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// Reads IEEE 1364 value change dumps.  Simulation time is mapped onto
+// cycles either by the rising edges of a clock, by a fixed sample
+// period, or one cycle per timestamp; each cycle is handed to the data
+// like a timeslice of the text format.
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+#include "parse.h"
+#include <ctype.h>
+#include <stdlib.h>
+
+using namespace timing;
+using namespace std;
+
+namespace {
+
+  class vcd_reader {
+    FILE *in;
+    char buf[65536];
+    size_t pos, len;
+
+    int next (void) {
+      if (pos == len) {
+	len = fread (buf, 1, sizeof (buf), in);
+	pos = 0;
+	if (len == 0)
+	  return EOF;
+      }
+      return (unsigned char) buf[pos++];
+    }
+
+  public:
+    int line;
+
+    vcd_reader (FILE *f) : in (f), pos (0), len (0), line (1) { }
+
+    // the next whitespace separated word, false at the end of file
+    bool word (string &w) {
+      int c;
+      while ((c = next ()) != EOF && (c == ' ' || c == '\t' || c == '\r' || c == '\n'))
+	if (c == '\n')
+	  ++ line;
+      if (c == EOF)
+	return false;
+      w.erase ();
+      do
+	w += (char) c;
+      while ((c = next ()) != EOF && c != ' ' && c != '\t' && c != '\r' && c != '\n');
+      if (c == '\n')
+	++ line;
+      return true;
+    }
+
+    // skip the rest of a $command
+    bool skip (string &w) {
+      while (word (w))
+	if (w == "$end")
+	  return true;
+      return false;
+    }
+  };
+
+  struct vcd_var {
+    unsigned width;
+    signal_sequence ids;	// the signals showing this variable
+    string raw;			// last value dumped
+    char kind;			// 's'calar, 'b'inary, 'r'eal
+    bool dirty;			// changed since the last cycle
+    bool clock;
+    sigvalue last;		// value of the signals in the last cycle
+    bool shown;
+  };
+
+  class vcd_loader {
+    vcd_reader &in;
+    parse_context &ctx;
+    const vcd_options &opt;
+    const char *filename;
+
+    vector<vcd_var> vars;
+    map<string, unsigned> codes;
+    vector<unsigned> changed;	// vars which are dirty
+    vector<string> scope;
+    int clock;			// var index of the clock, or -1
+    bool edge;			// clock rose at the current time
+
+  public:
+    vcd_loader (vcd_reader &r, parse_context &c, const vcd_options &o,
+		const char *f)
+      : in (r), ctx (c), opt (o), filename (f), clock (-1), edge (false) { }
+
+    int load (void);
+
+  private:
+    int error (const char *msg);
+    bool selected (const string &name, const string &leaf) const;
+    void declare (const string &code, unsigned width, const string &ref);
+    void change (char kind, const string &value, const string &code);
+    sigvalue convert (const vcd_var &var);
+    void cycle (void);
+  };
+};
+
+// ------------------------------------------------------------
+
+static string sanitize (const string &s) {
+  // signal names are words joined by periods, see scanner.ll
+  string r;
+  for (string::size_type i = 0; i < s.size (); ++ i) {
+    char c = s[i];
+    if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')
+	|| (c >= '0' && c <= '9') || c == '_')
+      r += c;
+    else if (!r.empty () && r[r.size () - 1] != '_')
+      r += '_';
+  }
+  while (!r.empty () && r[r.size () - 1] == '_')
+    r.erase (r.size () - 1);
+  return r.empty () ? "_" : r;
+}
+
+// ------------------------------------------------------------
+
+int vcd_loader::error (const char *msg) {
+  cerr << filename << ":" << in.line << ": " << msg << endl;
+  return 1;
+}
+
+// ------------------------------------------------------------
+
+bool vcd_loader::selected (const string &name, const string &leaf) const {
+  if (opt.signals.empty ())
+    return true;
+  for (vector<string>::const_iterator i = opt.signals.begin ();
+       i != opt.signals.end (); ++ i)
+    if (*i == name || *i == leaf)
+      return true;
+  return false;
+}
+
+// ------------------------------------------------------------
+
+void vcd_loader::declare (const string &code, unsigned width, const string &ref) {
+  // the name is the scope path below opt.scope, then the reference
+  string path;
+  for (vector<string>::const_iterator i = scope.begin (); i != scope.end (); ++ i)
+    path += *i + ".";
+  if (path.compare (0, opt.scope.size (), opt.scope) != 0
+      || (!opt.scope.empty () && path.size () > opt.scope.size ()
+	  && path[opt.scope.size ()] != '.'))
+    return;
+  string leaf = sanitize (ref);
+  string name = path.substr (opt.scope.empty () ? 0 : opt.scope.size () + 1) + leaf;
+
+  bool is_clock = opt.period == 0 && !opt.clock.empty ()
+    && (opt.clock == name || opt.clock == leaf);
+  if (!is_clock && !selected (name, leaf))
+    return;
+  sigid id = ctx.tdata.signal_id (name);
+  if (!is_clock && id == no_signal)
+    return;
+
+  map<string, unsigned>::iterator i = codes.find (code);
+  if (i == codes.end ()) {
+    vcd_var v;
+    v.width = width;
+    v.kind = 's';
+    v.dirty = false;
+    v.clock = false;
+    v.shown = false;
+    i = codes.insert (make_pair (code, (unsigned) vars.size ())).first;
+    vars.push_back (v);
+  }
+  vcd_var &var = vars[i->second];
+  if (is_clock && clock < 0) {
+    var.clock = true;
+    clock = i->second;
+  }
+  if (id != no_signal)
+    var.ids.push_back (id);
+}
+
+// ------------------------------------------------------------
+
+void vcd_loader::change (char kind, const string &value, const string &code) {
+  map<string, unsigned>::iterator i = codes.find (code);
+  if (i == codes.end ())
+    return;
+  vcd_var &var = vars[i->second];
+
+  if (var.clock && var.raw == "0" && value == "1")
+    edge = true;
+  var.kind = kind;
+  var.raw = value;
+  if (!var.dirty) {
+    var.dirty = true;
+    changed.push_back (i->second);
+  }
+}
+
+// ------------------------------------------------------------
+
+sigvalue vcd_loader::convert (const vcd_var &var) {
+  timing::data &d = ctx.tdata;
+  const string &raw = var.raw;
+
+  if (var.kind == 'r')
+    return d.value (raw, STATE);
+  if (var.kind == 's' || var.width <= 1) {
+    switch (raw.empty () ? 'x' : raw[raw.size () - 1]) {
+    case '0': return d.value ("0", ZERO);
+    case '1': return d.value ("1", ONE);
+    case 'z': case 'Z': return d.value ("Z", Z);
+    default: return d.value ("X", X);
+    }
+  }
+
+  // extend to the full width as the dump leaves out leading zeros
+  string bits (raw.empty () ? "x" : raw);
+  if (bits.size () < var.width) {
+    char fill = (bits[0] == 'x' || bits[0] == 'X' || bits[0] == 'z'
+		 || bits[0] == 'Z') ? bits[0] : '0';
+    bits.insert (0, var.width - bits.size (), fill);
+  }
+
+  // in hex, with X or Z for undefined digits
+  static const char hex[] = "0123456789ABCDEF";
+  string text;
+  bool all_x = true, all_z = true;
+  for (unsigned k = bits.size () % 4 ? bits.size () % 4 : 4, i = 0;
+       i < bits.size (); i += k, k = 4) {
+    int n = 0, nx = 0, nz = 0;
+    for (unsigned j = i; j < i + k; ++ j) {
+      n <<= 1;
+      switch (bits[j]) {
+      case '1': n |= 1; break;
+      case '0': break;
+      case 'z': case 'Z': ++ nz; break;
+      default: ++ nx; break;
+      }
+    }
+    if (nz == (int) k)
+      text += 'Z', all_x = false;
+    else if (nx || nz)
+      text += 'X', all_z = false;
+    else
+      text += hex[n], all_x = all_z = false;
+  }
+  if (all_x)
+    return d.value ("X", X);
+  if (all_z)
+    return d.value ("Z", Z);
+  return d.value (text, STATE);
+}
+
+// ------------------------------------------------------------
+
+void vcd_loader::cycle (void) {
+  // set the signals which have changed since the last cycle
+  for (vector<unsigned>::const_iterator i = changed.begin (); i != changed.end (); ++ i) {
+    vcd_var &var = vars[*i];
+    var.dirty = false;
+    if (var.clock)
+      continue;
+    sigvalue value = convert (var);
+    if (var.shown && value == var.last)
+      continue;
+    for (signal_sequence::const_iterator j = var.ids.begin (); j != var.ids.end (); ++ j)
+      ctx.tdata.set_value (*j, ctx.n, value);
+    var.last = value;
+    var.shown = true;
+  }
+  changed.clear ();
+
+  // the clock itself is drawn as a tick in every cycle
+  if (clock >= 0 && !vars[clock].shown) {
+    sigvalue tick = ctx.tdata.value ("tick", TICK);
+    for (signal_sequence::const_iterator j = vars[clock].ids.begin ();
+	 j != vars[clock].ids.end (); ++ j)
+      ctx.tdata.set_value (*j, ctx.n, tick);
+    vars[clock].shown = true;
+  }
+
+  ctx.deps.clear ();
+  ++ ctx.n;
+  ctx.end_timeslice ();
+}
+
+// ------------------------------------------------------------
+
+int vcd_loader::load (void) {
+  string w, type, size, code, ref;
+
+  // declarations
+  for (;;) {
+    if (!in.word (w))
+      return error ("missing $enddefinitions");
+    if (w == "$scope") {
+      if (!in.word (type) || !in.word (ref))
+	return error ("bad $scope");
+      scope.push_back (sanitize (ref));
+      if (!in.skip (w))
+	return error ("missing $end");
+    }
+    else if (w == "$upscope") {
+      if (!scope.empty ())
+	scope.pop_back ();
+      if (!in.skip (w))
+	return error ("missing $end");
+    }
+    else if (w == "$var") {
+      if (!in.word (type) || !in.word (size) || !in.word (code) || !in.word (ref))
+	return error ("bad $var");
+      declare (code, atoi (size.c_str ()), ref);
+      if (!in.skip (w))
+	return error ("missing $end");
+    }
+    else if (w == "$enddefinitions") {
+      if (!in.skip (w))
+	return error ("missing $end");
+      break;
+    }
+    else if (w[0] == '$') {
+      if (!in.skip (w))
+	return error ("missing $end");
+    }
+    else
+      return error ("unexpected text in declarations");
+  }
+
+  if (!opt.clock.empty () && opt.period == 0 && clock < 0) {
+    cerr << filename << ": clock signal \"" << opt.clock << "\" not found" << endl;
+    return 1;
+  }
+
+  // value changes
+  bool started = false;
+  unsigned long long now = 0, sample = 0;
+  while (in.word (w)) {
+    switch (w[0]) {
+    case '#': {
+      unsigned long long t = strtoull (w.c_str () + 1, NULL, 10);
+      if (!started)
+	sample = t;
+      else if (t > now) {
+	if (opt.period) {
+	  while (sample < t) {
+	    cycle ();
+	    sample += opt.period;
+	  }
+	}
+	else if (opt.clock.empty () || edge) {
+	  cycle ();
+	  edge = false;
+	}
+      }
+      now = t;
+      started = true;
+      break;
+    }
+
+    case '0': case '1': case 'x': case 'X': case 'z': case 'Z':
+      change ('s', w.substr (0, 1), w.substr (1));
+      break;
+
+    case 'b': case 'B': case 'r': case 'R':
+      if (!in.word (code))
+	return error ("missing identifier");
+      change (tolower (w[0]), w.substr (1), code);
+      break;
+
+    case '$':
+      // $dumpvars and friends only bracket value changes
+      if (w == "$comment" && !in.skip (w))
+	return error ("missing $end");
+      break;
+
+    default:
+      return error ("bad value change");
+    }
+  }
+
+  // the changes at the last timestamp
+  if (!started)
+    return 0;
+  if (opt.period) {
+    while (sample <= now) {
+      cycle ();
+      sample += opt.period;
+    }
+  }
+  else if (opt.clock.empty () || edge)
+    cycle ();
+
+  return 0;
+}
+
+// ------------------------------------------------------------
+
+int timing::read_vcd (const char *filename, parse_context &ctx,
+		      const vcd_options &opt) {
+  FILE *f = fopen (filename, "rb");
+  if (f == NULL)
+    return -1;
+  vcd_reader in (f);
+  vcd_loader loader (in, ctx, opt, filename);
+  int result = loader.load ();
+  fclose (f);
+  return result;
+}